@@ -0,0 +1,103 @@
+#include "AllocCheck.h"
+#include "ofMain.h"
+#include "FaceTrackerAdapter.h"
+#include "FlowInputs.h"
+#include "Profiler.h"
+#include "SmileFlow.h"
+#include "SyntheticLandmarks.h"
+#include "ViewRenderer.h"
+#include <cstdlib>
+#include <new>
+
+#if STROKE_PROFILE
+namespace {
+thread_local uint64_t t_allocs = 0;
+
+void* countedAlloc(std::size_t n) {
+    ++t_allocs;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+} // namespace
+
+void* operator new(std::size_t n)   { return countedAlloc(n); }
+void* operator new[](std::size_t n) { return countedAlloc(n); }
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept {
+    ++t_allocs;
+    return std::malloc(n ? n : 1);
+}
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept {
+    ++t_allocs;
+    return std::malloc(n ? n : 1);
+}
+void operator delete(void* p) noexcept   { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept   { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept   { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+#endif
+
+namespace alloccheck {
+
+bool enabled() {
+    return STROKE_PROFILE != 0;
+}
+
+uint64_t threadAllocations() {
+#if STROKE_PROFILE
+    return t_allocs;
+#else
+    return 0;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    int frames = 300;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--frames" && i + 1 < argc) frames = ofToInt(argv[++i]);
+    }
+    if (!enabled()) {
+        ofLogError("alloc-check") << "allocation counting needs a build with STROKE_PROFILE (make alloc-check)";
+        return 2;
+    }
+
+    std::vector<std::vector<synth::SynthFrame>> sessions;
+    for (int s = 0; s < synth::kNumScenarios; ++s) {
+        sessions.push_back(synth::makeSequence((synth::Scenario)s, frames));
+    }
+
+    // What the tracker thread does per frame once landmarks are in, plus the
+    // render-side copy of the result.
+    const guide::Oval oval = guide::geometryFor(guide::kReferenceWidth, guide::kReferenceHeight).oval;
+    SmileFlow    flow;
+    DerolledData der;
+    RenderData   rd;
+    auto frame = [&](const synth::SynthFrame& f) {
+        bool haveDer = f.hasFace && FaceTrackerAdapter::deroll(f.points, oval, der);
+        flow.update(makeFlowInputs(f.hasFace, haveDer, der, f.dt));
+        rd.stage             = flow.stage();
+        rd.abnormal          = flow.abnormal();
+        rd.lines             = &flow.uiLines();
+        rd.stabilityProgress = flow.stabilityProgress();
+        rd.smileIntensity    = flow.smileIntensity();
+        rd.smileAsymmetry    = flow.smileAsymmetry();
+    };
+    auto pass = [&]() {
+        for (const auto& session : sessions) {
+            flow.reset();
+            for (const auto& f : session) frame(f);
+        }
+    };
+
+    pass(); // warm-up: UI line buffers reach their working size
+    uint64_t before = threadAllocations();
+    pass();
+    uint64_t allocs = threadAllocations() - before;
+
+    size_t total = sessions.size() * (size_t)frames;
+    ofLogNotice("alloc-check") << allocs << " allocations over " << total << " frames";
+    return allocs == 0 ? 0 : 1;
+}
+
+} // namespace alloccheck
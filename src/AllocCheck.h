@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// Counts heap allocations so the per-frame data path can be checked for
+// steady-state allocations. The counting operator new is only linked into
+// builds with STROKE_PROFILE (debug); elsewhere enabled() is false.
+namespace alloccheck {
+
+bool     enabled();
+uint64_t threadAllocations(); // allocations made by the calling thread so far
+
+// Entry point for `--alloc-check [--frames n]`: drives synthetic sessions
+// through deroll -> SmileFlow -> UI text and fails if the second pass allocates.
+int main(int argc, char* argv[]);
+
+} // namespace alloccheck
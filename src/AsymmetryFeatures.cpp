@@ -0,0 +1,40 @@
+#include "AsymmetryFeatures.h"
+
+namespace features {
+
+const char* regionName(Region r) {
+    switch (r) {
+        case MOUTH_CORNER: return "mouth_corner";
+        case BROW:         return "brow";
+        case EYE_CLOSURE:  return "eye_closure";
+        case NASOLABIAL:   return "nasolabial";
+        default:           return "unknown";
+    }
+}
+
+void AsymmetryExtractor::calibrate(const LandmarkFrame& ptsDerolled) {
+    measure(ptsDerolled, base_);
+    calibrated_ = true;
+}
+
+void AsymmetryExtractor::extract(const LandmarkFrame& ptsDerolled, float iod, Vector& out) const {
+    if (!calibrated_) {
+        out.fill(0.f);
+        return;
+    }
+    Measures m;
+    measure(ptsDerolled, m);
+    // Image y grows downwards, so baseline minus now is a raise, a closing
+    // eye or a shortening fold.
+    const float inv = 1.f / std::max(1.f, iod);
+    for (int r = 0; r < kNumRegions; ++r) {
+        float l  = (base_[r * kNumSides + LEFT]  - m[r * kNumSides + LEFT])  * inv;
+        float rt = (base_[r * kNumSides + RIGHT] - m[r * kNumSides + RIGHT]) * inv;
+        float meanAbs = 0.5f * (std::abs(l) + std::abs(rt));
+        out[featureIndex(Region(r), LEFT_DISPLACEMENT)]  = l;
+        out[featureIndex(Region(r), RIGHT_DISPLACEMENT)] = rt;
+        out[featureIndex(Region(r), ASYMMETRY)] = std::abs(l - rt) / std::max(meanAbs, min_displacement);
+    }
+}
+
+} // namespace features
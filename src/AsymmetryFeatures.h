@@ -0,0 +1,119 @@
+#pragma once
+#include "ofMain.h"
+#include <array>
+#include <cstdint>
+#include "Landmarks68.h"
+#include "LandmarkFrame.h"
+
+// Left/right displacement features of several facial regions, from derolled
+// landmarks. Every region's measure on each side is a weighted sum of
+// landmark y coordinates, so one table of (point, slot, weight) taps, built
+// at compile time from Landmarks68.h and sorted by point, yields all of
+// them in a single forward pass over the array. A new region is a few more
+// taps, not another pass.
+namespace features {
+
+enum Region { MOUTH_CORNER = 0, BROW, EYE_CLOSURE, NASOLABIAL };
+static constexpr int kNumRegions = NASOLABIAL + 1;
+const char* regionName(Region r);
+
+enum Side { LEFT = 0, RIGHT };
+static constexpr int kNumSides = 2;
+
+// Per region: left and right displacement from the neutral baseline in
+// IODs (positive for a raise, a closing eye or a shortening fold) and their
+// asymmetry |left - right| / mean(|left|, |right|).
+enum Component { LEFT_DISPLACEMENT = 0, RIGHT_DISPLACEMENT, ASYMMETRY };
+static constexpr int kNumComponents = ASYMMETRY + 1;
+static constexpr int kNumFeatures = kNumRegions * kNumComponents;
+constexpr int featureIndex(Region r, Component c) { return int(r) * kNumComponents + int(c); }
+
+using Vector   = std::array<float, kNumFeatures>;
+using Measures = std::array<float, kNumRegions * kNumSides>; // pixels, [region][side]
+
+namespace detail {
+
+struct Tap {
+    uint8_t point;
+    uint8_t slot;   // region * kNumSides + side
+    float   weight;
+};
+
+static constexpr int kMaxTaps = 32;
+
+struct TapTable {
+    std::array<Tap, kMaxTaps> taps{};
+    int count = 0;
+    constexpr void add(int point, Region r, Side s, float weight) {
+        taps[count++] = Tap{ (uint8_t)point, (uint8_t)(int(r) * kNumSides + int(s)), weight };
+    }
+    constexpr void addRange(int first, int last, Region r, Side s) {
+        for (int i = first; i <= last; ++i) add(i, r, s, 1.f / float(last - first + 1));
+    }
+};
+
+constexpr TapTable buildTaps() {
+    TapTable t;
+    // Mouth corner height.
+    t.add(LM_LEFT_MOUTH_CORNER,  MOUTH_CORNER, LEFT,  1.f);
+    t.add(LM_RIGHT_MOUTH_CORNER, MOUTH_CORNER, RIGHT, 1.f);
+    // Mean brow height.
+    t.addRange(LM_LEFT_BROW_START,  LM_LEFT_BROW_END,  BROW, LEFT);
+    t.addRange(LM_RIGHT_BROW_START, LM_RIGHT_BROW_END, BROW, RIGHT);
+    // Eye aperture: mean of the two lower-lid points minus the two upper-lid
+    // points above them (corner, upper, upper, corner, lower, lower).
+    const int eyes[kNumSides] = { LM_LEFT_EYE_START, LM_RIGHT_EYE_START };
+    for (int s = 0; s < kNumSides; ++s) {
+        t.add(eyes[s] + 1, EYE_CLOSURE, Side(s), -0.5f);
+        t.add(eyes[s] + 2, EYE_CLOSURE, Side(s), -0.5f);
+        t.add(eyes[s] + 4, EYE_CLOSURE, Side(s),  0.5f);
+        t.add(eyes[s] + 5, EYE_CLOSURE, Side(s),  0.5f);
+    }
+    // Nasolabial length: mouth corner below the outer nostril.
+    t.add(LM_LEFT_MOUTH_CORNER,  NASOLABIAL, LEFT,   1.f);
+    t.add(LM_NOSE_BASE_START,    NASOLABIAL, LEFT,  -1.f);
+    t.add(LM_RIGHT_MOUTH_CORNER, NASOLABIAL, RIGHT,  1.f);
+    t.add(LM_NOSE_BASE_END,      NASOLABIAL, RIGHT, -1.f);
+
+    // Walk the points in memory order.
+    for (int i = 1; i < t.count; ++i) {
+        Tap tap = t.taps[i];
+        int j = i;
+        for (; j > 0 && t.taps[j - 1].point > tap.point; --j) t.taps[j] = t.taps[j - 1];
+        t.taps[j] = tap;
+    }
+    return t;
+}
+
+} // namespace detail
+
+inline constexpr detail::TapTable kTaps = detail::buildTaps();
+static_assert(kTaps.count <= detail::kMaxTaps, "grow kMaxTaps");
+
+// All regions' measures of one set of points, in one pass.
+inline void measure(const LandmarkFrame& pts, Measures& out) {
+    out.fill(0.f);
+    for (int i = 0; i < kTaps.count; ++i) {
+        const detail::Tap& t = kTaps.taps[i];
+        out[t.slot] += t.weight * pts[t.point].y;
+    }
+}
+
+class AsymmetryExtractor {
+public:
+    // Floor of the asymmetry denominator, IODs, so a region that barely
+    // moves does not report noise as asymmetry.
+    float min_displacement = 0.02f;
+
+    void reset() { calibrated_ = false; }
+    void calibrate(const LandmarkFrame& ptsDerolled);
+    bool isCalibrated() const { return calibrated_; }
+    // Zeroes without a baseline.
+    void extract(const LandmarkFrame& ptsDerolled, float iod, Vector& out) const;
+
+private:
+    Measures base_{};
+    bool     calibrated_ = false;
+};
+
+} // namespace features
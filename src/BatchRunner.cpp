@@ -0,0 +1,275 @@
+#include "BatchRunner.h"
+#include "FlowInputs.h"
+#include "WorkStealingPool.h"
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+void BatchRunner::setup(const Settings& s, std::shared_ptr<const LandmarkModel> model) {
+    settings_ = s;
+    if (auto d = detectors::make(s.detector)) tracker_.setDetector(std::move(d));
+    tracker_.setup(std::move(model));
+    tracker_.setDetectionPolicy(s.detection);
+    tracker_.setTrackingScale(s.trackingScale);
+    tracker_.setInferencePolicy(s.inference);
+    tracker_.setFrameGate(s.gate);
+    flow_.setHoldStillSeconds(s.holdStillSeconds);
+    flow_.setSmileHoldSeconds(s.smileHoldSeconds);
+}
+
+SessionVerdict BatchRunner::run(const std::string& clip) {
+    SessionVerdict v;
+    v.clip = clip;
+    v.stageEnteredAt.fill(-1.0);
+    v.stageSeconds.fill(0.0);
+
+    auto src = frames::open(clip, settings_.sequenceFps);
+    if (!src) return v;
+    v.opened = true;
+
+    auto wallStart = std::chrono::steady_clock::now();
+    FaceTrackerAdapter::DetectionStats detectBefore = tracker_.detectionStats();
+    const uint64_t predictedBefore = tracker_.predictedFrames();
+    const FrameGate::Stats gateBefore = tracker_.frameGate().stats();
+    tracker_.reset();
+    flow_.reset();
+    v.stageEnteredAt[flow_.stage()] = 0.0;
+
+    double last = 0.0;
+    bool   first = true;
+    SubjectWatch subjects;
+    while (src->next(frame_)) {
+        float dt = first ? 0.f : (float)std::max(0.0, frame_.timestamp - last);
+        last = frame_.timestamp;
+        first = false;
+
+        SmileFlow::Stage before = flow_.stage();
+        tracker_.update(frame_.pixels);
+        if (subjects.changed(tracker_.subject(), flow_.stage())) flow_.reset();
+        flow_.update(makeFlowInputs(tracker_, der_, dt));
+        if (!settings_.recordDir.empty()) {
+            if (v.frames == 0) {
+                const guide::GuideGeometry& g = tracker_.geometry();
+                recorder_.open(ofFilePath::join(settings_.recordDir, ofFilePath::getBaseName(clip) + ".lmk"),
+                               g.frameWidth, g.frameHeight);
+            }
+            if (recorder_.isOpen()) {
+                const bool hasFace = tracker_.hasFace();
+                fillRecord(recorder_.next(), frame_.timestamp, hasFace,
+                           hasFace ? &tracker_.faces().front().points : nullptr, der_, v.frames == 0,
+                           tracker_.measured());
+                recorder_.commit();
+            }
+        }
+        v.stageSeconds[before] += dt;
+        v.frames++;
+
+        SmileFlow::Stage after = flow_.stage();
+        if (after != before && v.stageEnteredAt[after] < 0) {
+            v.stageEnteredAt[after] = frame_.timestamp;
+        }
+        if (after == SmileFlow::STAGE_EVALUATE && settings_.stopAtVerdict) break;
+    }
+
+    recorder_.close();
+    v.mediaSeconds = last;
+    v.wallSeconds  = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    v.detectSeconds     = tracker_.detectionStats().seconds - detectBefore.seconds;
+    v.fullFrameSearches = tracker_.detectionStats().fullFrameSearches - detectBefore.fullFrameSearches;
+    v.predictedFrames   = tracker_.predictedFrames() - predictedBefore;
+    const FrameGate::Stats& gate = tracker_.frameGate().stats();
+    v.gateDark   = gate.dark - gateBefore.dark;
+    v.gateBright = gate.bright - gateBefore.bright;
+    v.gateBlurry = gate.blurry - gateBefore.blurry;
+    v.completed    = flow_.stage() == SmileFlow::STAGE_EVALUATE;
+    v.abnormal     = flow_.abnormal();
+    v.intensity    = flow_.smileIntensity();
+    v.asymmetry    = flow_.smileAsymmetry();
+    v.features     = flow_.features();
+    return v;
+}
+
+namespace batch {
+bool writeCsv(const std::string& path, const std::vector<SessionVerdict>& verdicts) {
+    std::ofstream out(ofToDataPath(path, true));
+    if (!out) return false;
+    out << "clip,opened,frames,media_s,wall_s,detect_s,full_frame_searches,predicted_frames,"
+           "gate_dark,gate_bright,gate_blurry,completed,abnormal,intensity,asymmetry";
+    for (int s = 0; s < SmileFlow::kNumStages; ++s) {
+        const char* n = SmileFlow::stageName((SmileFlow::Stage)s);
+        out << "," << n << "_at_s," << n << "_s";
+    }
+    for (int r = 0; r < features::kNumRegions; ++r) {
+        const char* n = features::regionName((features::Region)r);
+        out << "," << n << "_left," << n << "_right," << n << "_asym";
+    }
+    out << "\n";
+    for (const auto& v : verdicts) {
+        out << '"' << v.clip << '"' << "," << v.opened << "," << v.frames << ","
+            << v.mediaSeconds << "," << v.wallSeconds << ","
+            << v.detectSeconds << "," << v.fullFrameSearches << "," << v.predictedFrames << ","
+            << v.gateDark << "," << v.gateBright << "," << v.gateBlurry << ","
+            << v.completed << "," << v.abnormal << ","
+            << v.intensity << "," << v.asymmetry;
+        for (int s = 0; s < SmileFlow::kNumStages; ++s) {
+            out << "," << v.stageEnteredAt[s] << "," << v.stageSeconds[s];
+        }
+        for (float f : v.features) out << "," << f;
+        out << "\n";
+    }
+    return true;
+}
+
+bool writeJson(const std::string& path, const std::vector<SessionVerdict>& verdicts) {
+    ofJson arr = ofJson::array();
+    for (const auto& v : verdicts) {
+        ofJson stages = ofJson::object();
+        for (int s = 0; s < SmileFlow::kNumStages; ++s) {
+            stages[SmileFlow::stageName((SmileFlow::Stage)s)] = {
+                { "entered_at", v.stageEnteredAt[s] },
+                { "seconds",    v.stageSeconds[s] }
+            };
+        }
+        ofJson regions = ofJson::object();
+        for (int r = 0; r < features::kNumRegions; ++r) {
+            const features::Region region = (features::Region)r;
+            regions[features::regionName(region)] = {
+                { "left",      v.features[features::featureIndex(region, features::LEFT_DISPLACEMENT)] },
+                { "right",     v.features[features::featureIndex(region, features::RIGHT_DISPLACEMENT)] },
+                { "asymmetry", v.features[features::featureIndex(region, features::ASYMMETRY)] }
+            };
+        }
+        arr.push_back({
+            { "clip",      v.clip },
+            { "opened",    v.opened },
+            { "frames",    v.frames },
+            { "media_s",   v.mediaSeconds },
+            { "wall_s",    v.wallSeconds },
+            { "detect_s",  v.detectSeconds },
+            { "full_frame_searches", v.fullFrameSearches },
+            { "predicted_frames", v.predictedFrames },
+            { "gate_dark",   v.gateDark },
+            { "gate_bright", v.gateBright },
+            { "gate_blurry", v.gateBlurry },
+            { "completed", v.completed },
+            { "abnormal",  v.abnormal },
+            { "intensity", v.intensity },
+            { "asymmetry", v.asymmetry },
+            { "stages",    stages },
+            { "regions",   regions }
+        });
+    }
+    return ofSavePrettyJson(path, arr);
+}
+
+bool writeWorkerCsv(const std::string& path, const std::vector<WorkerStats>& workers, double wallSeconds) {
+    std::ofstream out(ofToDataPath(path, true));
+    if (!out) return false;
+    out << "worker,clips,frames,busy_s,clips_per_s,frames_per_s,utilization\n";
+    for (size_t w = 0; w < workers.size(); ++w) {
+        const auto& ws = workers[w];
+        double busy = std::max(1e-9, ws.busySeconds);
+        out << w << "," << ws.clips << "," << ws.frames << "," << ws.busySeconds << ","
+            << ws.clips / busy << "," << ws.frames / busy << ","
+            << ws.busySeconds / std::max(1e-9, wallSeconds) << "\n";
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    BatchRunner::Settings settings;
+    std::string csvPath = "verdicts.csv";
+    std::string jsonPath;
+    std::string workerCsvPath;
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if      (a == "--model")       settings.modelPath = value();
+        else if (a == "--csv")         csvPath = value();
+        else if (a == "--json")        jsonPath = value();
+        else if (a == "--workers-csv") workerCsvPath = value();
+        else if (a == "--jobs")        jobs = std::max(1, ofToInt(value()));
+        else if (a == "--fps")         settings.sequenceFps = ofToDouble(value());
+        else if (a == "--hold")        settings.holdStillSeconds = ofToFloat(value());
+        else if (a == "--smile-hold")  settings.smileHoldSeconds = ofToFloat(value());
+        else if (a == "--full")        settings.stopAtVerdict = false;
+        else if (a == "--full-frame")  settings.detection.useRoi = false;
+        else if (a == "--detector")    settings.detector = value();
+        else if (a == "--redetect")    settings.detection.fullFrameEvery = std::max(1, ofToInt(value()));
+        else if (a == "--record-dir")  settings.recordDir = value();
+        else if (a == "--track-scale") settings.trackingScale = ofToFloat(value());
+        else if (a == "--infer-every") settings.inference.every = std::max(1, ofToInt(value()));
+        else if (a == "--infer-speed") settings.inference.maxSpeed = ofToFloat(value());
+        else if (a == "--infer-change") settings.inference.maxImageChange = ofToFloat(value());
+        else if (a == "--no-gate")     settings.gate.enabled = false;
+        else if (a == "--gate-sharpness") settings.gate.minSharpness = ofToFloat(value());
+        else if (a == "--roi-pad")     settings.detection.ovalPadding = settings.detection.facePadding = ofToFloat(value());
+        else inputs.push_back(a);
+    }
+
+    auto clips = frames::collectClips(inputs);
+    if (clips.empty()) {
+        ofLogError("batch") << "usage: --batch [--model p] [--jobs n] [--csv out.csv] [--json out.json] "
+                               "[--workers-csv w.csv] [--fps n] [--hold s] [--smile-hold s] [--full] "
+                               "[--full-frame] [--detector name] [--redetect n] [--roi-pad f] [--track-scale f] [--record-dir d] "
+                               "[--infer-every n] [--infer-speed f] [--infer-change f] [--no-gate] [--gate-sharpness f] "
+                               "<clip|dir>...";
+        return 2;
+    }
+    if (!detectors::make(settings.detector)) {
+        ofLogError("batch") << "usage: --detector hog[:threads]|haar|reuse[:name]";
+        return 2;
+    }
+    jobs = std::min(jobs, clips.size());
+
+    auto model = LandmarkModel::shared(settings.modelPath);
+    if (!model) return 1;
+
+    // Parallelism comes from the clip pool; nested OpenCV threads would only contend.
+    if (jobs > 1) cv::setNumThreads(1);
+
+    std::vector<BatchRunner> runners(jobs);
+    for (auto& r : runners) r.setup(settings, model);
+
+    std::vector<SessionVerdict> verdicts(clips.size());
+    std::vector<WorkerStats>    workers(jobs);
+    auto wallStart = std::chrono::steady_clock::now();
+
+    WorkStealingPool pool(jobs);
+    pool.run(clips.size(), [&](size_t w, size_t task) {
+        auto t0 = std::chrono::steady_clock::now();
+        verdicts[task] = runners[w].run(clips[task]);
+        const auto& v = verdicts[task];
+        workers[w].clips++;
+        workers[w].frames += v.frames;
+        workers[w].busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        ofLogVerbose("batch") << "[" << w << "] " << v.clip << ": " << v.frames << " frames, "
+                              << (v.completed ? (v.abnormal ? "ABNORMAL" : "normal") : "incomplete");
+    });
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    size_t totalFrames = 0, gated = 0;
+    for (const auto& v : verdicts) gated += v.gateDark + v.gateBright + v.gateBlurry;
+    for (size_t w = 0; w < workers.size(); ++w) {
+        const auto& ws = workers[w];
+        double busy = std::max(1e-9, ws.busySeconds);
+        totalFrames += ws.frames;
+        ofLogNotice("batch") << "worker " << w << ": " << ws.clips << " clips, "
+                             << ofToString(ws.clips / busy, 2) << " clips/s, "
+                             << ofToString(ws.frames / busy, 1) << " frames/s";
+    }
+    ofLogNotice("batch") << clips.size() << " clips on " << jobs << " workers in "
+                         << ofToString(wall, 2) << " s: "
+                         << ofToString(clips.size() / std::max(1e-9, wall), 2) << " clips/s, "
+                         << ofToString(totalFrames / std::max(1e-9, wall), 1) << " frames/s, "
+                         << ofToString(100.0 * gated / std::max<size_t>(1, totalFrames), 1) << "% gated";
+
+    bool ok = writeCsv(csvPath, verdicts);
+    if (!jsonPath.empty())      ok = writeJson(jsonPath, verdicts) && ok;
+    if (!workerCsvPath.empty()) ok = writeWorkerCsv(workerCsvPath, workers, wall) && ok;
+    return ok ? 0 : 1;
+}
+} // namespace batch
@@ -0,0 +1,76 @@
+#pragma once
+#include "ofMain.h"
+#include <array>
+#include <string>
+#include <vector>
+#include "FaceTrackerAdapter.h"
+#include "FrameSource.h"
+#include "LandmarkRecording.h"
+#include "SmileFlow.h"
+
+struct SessionVerdict {
+    std::string clip;
+    bool   opened = false;
+    size_t frames = 0;
+    double mediaSeconds = 0; // timestamp of the last frame processed
+    double wallSeconds = 0;  // processing time
+    double detectSeconds = 0; // part of wallSeconds spent in face detection
+    size_t fullFrameSearches = 0;
+    size_t predictedFrames = 0;  // frames whose landmarks were predicted, not fitted
+    // Frames the frame gate rejected, by reason; see FrameGate.
+    size_t gateDark = 0, gateBright = 0, gateBlurry = 0;
+    // Media time each stage was first entered (-1 if never) and time spent in it.
+    std::array<double, SmileFlow::kNumStages> stageEnteredAt{};
+    std::array<double, SmileFlow::kNumStages> stageSeconds{};
+    bool  completed = false; // reached STAGE_EVALUATE
+    bool  abnormal  = false;
+    float intensity = 0.f;
+    float asymmetry = 0.f;
+    features::Vector features{}; // SmileFlow::features() at the end
+};
+
+struct WorkerStats {
+    size_t clips = 0;
+    size_t frames = 0;
+    double busySeconds = 0; // wall time spent inside BatchRunner::run
+};
+
+// Runs the live pipeline (tracker -> derolling -> SmileFlow) over recorded
+// clips as fast as they decode. No window, GL context or camera involved.
+class BatchRunner {
+public:
+    struct Settings {
+        std::string modelPath = "model/shape_predictor_68_face_landmarks.dat";
+        float  holdStillSeconds = 1.5f;
+        float  smileHoldSeconds = 0.6f;
+        double sequenceFps = 30.0;   // frame rate assumed for image sequences
+        bool   stopAtVerdict = true; // stop decoding once STAGE_EVALUATE is reached
+        FaceTrackerAdapter::DetectionPolicy detection;
+        std::string detector = "hog"; // see detectors::make
+        float  trackingScale = 1.f;  // see FaceTrackerAdapter::setTrackingScale
+        FaceTrackerAdapter::InferencePolicy inference;
+        FrameGate::Settings gate;
+        std::string recordDir;       // non-empty: write <clip name>.lmk here for --replay
+    };
+
+    // The model is only read, so every runner in a process can share one.
+    void setup(const Settings& s, std::shared_ptr<const LandmarkModel> model);
+    SessionVerdict run(const std::string& clip);
+
+private:
+    Settings           settings_;
+    FaceTrackerAdapter tracker_;
+    SmileFlow          flow_;
+    DerolledData       der_;
+    Frame              frame_;
+    LandmarkRecorder   recorder_;
+};
+
+namespace batch {
+bool writeCsv(const std::string& path, const std::vector<SessionVerdict>& verdicts);
+bool writeJson(const std::string& path, const std::vector<SessionVerdict>& verdicts);
+bool writeWorkerCsv(const std::string& path, const std::vector<WorkerStats>& workers, double wallSeconds);
+// Entry point for `--batch [options] <clip|dir>...`. Clips are spread over
+// --jobs workers, each with its own tracker and flow. Returns the exit code.
+int main(int argc, char* argv[]);
+} // namespace batch
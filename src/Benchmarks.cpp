@@ -0,0 +1,363 @@
+#include "Benchmarks.h"
+#include "ofMain.h"
+#include "AsymmetryFeatures.h"
+#include "DerollKernels.h"
+#include "FaceTrackerAdapter.h"
+#include "FlowInputs.h"
+#include "GuideOval.h"
+#include "Math2D.h"
+#include "Metrics.h"
+#include "SmileEvaluator.h"
+#include "SmileFlow.h"
+#include "StabilityMonitor.h"
+#include "SyntheticLandmarks.h"
+#include <chrono>
+
+namespace bench {
+namespace {
+
+volatile float g_sink = 0.f;
+
+class Runner {
+public:
+    double minSeconds = 0.5;
+    std::string filter;
+    std::vector<Result> results;
+
+    template <class F>
+    void run(const std::string& name, const std::string& scenario, F&& op) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+        using clock = std::chrono::steady_clock;
+        auto timeBatch = [&](uint64_t n) {
+            auto t0 = clock::now();
+            for (uint64_t i = 0; i < n; ++i) op();
+            return std::chrono::duration<double>(clock::now() - t0).count();
+        };
+
+        // Grow the batch until one repetition fills its share of the time budget.
+        const int kReps = 7;
+        uint64_t batch = 1;
+        while (timeBatch(batch) < minSeconds / kReps && batch < (1ull << 40)) batch *= 2;
+
+        std::vector<double> ns;
+        for (int r = 0; r < kReps; ++r) ns.push_back(timeBatch(batch) * 1e9 / batch);
+        std::sort(ns.begin(), ns.end());
+
+        Result res;
+        res.name = name;
+        res.scenario = scenario;
+        res.nsPerOp = ns[ns.size() / 2];
+        res.nsMin = ns.front();
+        res.iterations = batch * kReps;
+        results.push_back(res);
+        ofLogNotice("bench") << name << " [" << scenario << "] "
+                             << ofToString(res.nsPerOp, 1) << " ns/op (min " << ofToString(res.nsMin, 1) << ")";
+    }
+};
+
+struct Stream {
+    std::string name;
+    std::vector<synth::SynthFrame> frames;
+    std::vector<DerolledData>      derolled;
+    std::vector<SmileFlow::Inputs> inputs;
+};
+
+// Synthetic faces are laid out on the reference frame.
+const guide::Oval kOval = guide::geometryFor(guide::kReferenceWidth, guide::kReferenceHeight).oval;
+
+Stream makeStream(synth::Scenario s) {
+    Stream st;
+    st.name = synth::scenarioName(s);
+    st.frames = synth::makeSequence(s, 300);
+    st.derolled.resize(st.frames.size());
+    for (size_t i = 0; i < st.frames.size(); ++i) {
+        const auto& f = st.frames[i];
+        bool have = f.hasFace && FaceTrackerAdapter::deroll(f.points, kOval, st.derolled[i]);
+        st.inputs.push_back(makeFlowInputs(f.hasFace, have, st.derolled[i], f.dt));
+    }
+    return st;
+}
+
+// Index of the next frame of the stream that has a face, starting at i.
+size_t nextFace(const Stream& st, size_t i) {
+    for (size_t k = 0; k < st.frames.size(); ++k) {
+        size_t j = (i + k) % st.frames.size();
+        if (st.frames[j].hasFace) return j;
+    }
+    return i % st.frames.size();
+}
+
+void runAll(Runner& r) {
+    std::vector<Stream> streams;
+    for (int s = 0; s < synth::kNumScenarios; ++s) streams.push_back(makeStream((synth::Scenario)s));
+
+    {
+        const auto& pts = streams[synth::NEUTRAL].frames.front().points;
+        glm::vec2 c(640.f, 400.f);
+        r.run("math2d::rotateAround", "68pts", [&] {
+            float acc = 0.f;
+            for (const auto& p : pts) acc += math2d::rotateAround(p, c, -0.08f).x;
+            g_sink = acc;
+        });
+    }
+
+    for (const auto& st : streams) {
+        size_t i = 0;
+        DerolledData der;
+        r.run("FaceTrackerAdapter::getDerolled", st.name, [&] {
+            i = nextFace(st, i + 1);
+            FaceTrackerAdapter::deroll(st.frames[i].points, kOval, der);
+            g_sink = der.iod;
+        });
+    }
+
+    // The derolling bookkeeping before the SIMD kernels: sin/cos per point via
+    // rotateAround, then a separate scalar containment pass.
+    const guide::Oval& oval = kOval;
+    for (const auto& st : streams) {
+        size_t i = 0;
+        LandmarkFrame out;
+        r.run("deroll legacy", st.name, [&] {
+            i = nextFace(st, i + 1);
+            const auto& pts = st.frames[i].points;
+            glm::vec2 l(0,0), rt(0,0);
+            for (int k = LM_LEFT_EYE_START;  k <= LM_LEFT_EYE_END;  ++k) l  += pts[k];
+            for (int k = LM_RIGHT_EYE_START; k <= LM_RIGHT_EYE_END; ++k) rt += pts[k];
+            l /= 6.f;
+            rt /= 6.f;
+            glm::vec2 c = 0.5f * (l + rt), d = rt - l;
+            float roll = std::atan2(d.y, d.x);
+            for (size_t k = 0; k < pts.size(); ++k) out[k] = math2d::rotateAround(pts[k], c, -roll);
+            g_sink = (float)kernels::countInsideScalar(out, oval);
+        });
+    }
+
+    for (const auto& st : streams) {
+        size_t i = 0;
+        LandmarkFrame out;
+        kernels::DerollResult res;
+        r.run("kernels::derollScalar", st.name, [&] {
+            i = nextFace(st, i + 1);
+            kernels::derollScalar(st.frames[i].points, oval, out, res);
+            g_sink = (float)res.inside;
+        });
+        r.run(std::string("kernels::deroll/") + kernels::isaName(), st.name, [&] {
+            i = nextFace(st, i + 1);
+            kernels::deroll(st.frames[i].points, oval, out, res);
+            g_sink = (float)res.inside;
+        });
+    }
+
+    for (const auto& st : streams) {
+        size_t i = 0;
+        r.run("kernels::countInsideScalar", st.name, [&] {
+            i = nextFace(st, i + 1);
+            g_sink = (float)kernels::countInsideScalar(st.derolled[i].points, oval);
+        });
+    }
+
+    for (const auto& st : streams) {
+        size_t i = 0;
+        r.run("guide::mostlyInsideGuide", st.name, [&] {
+            i = nextFace(st, i + 1);
+            g_sink = guide::mostlyInsideGuide(st.derolled[i].points, oval);
+        });
+    }
+
+    for (const auto& st : streams) {
+        SmileEvaluator ev;
+        const auto& base = st.derolled[nextFace(st, 0)];
+        ev.calibrate(base.points[LM_LEFT_MOUTH_CORNER], base.points[LM_RIGHT_MOUTH_CORNER], base.iod);
+        size_t i = 0;
+        r.run("SmileEvaluator::updateMetrics", st.name, [&] {
+            i = nextFace(st, i + 1);
+            ev.updateMetrics(st.derolled[i].points, st.derolled[i].iod);
+            g_sink = ev.asymmetry();
+        });
+    }
+
+    for (const auto& st : streams) {
+        features::AsymmetryExtractor ex;
+        ex.calibrate(st.derolled[nextFace(st, 0)].points);
+        features::Vector v;
+        size_t i = 0;
+        r.run("features::AsymmetryExtractor::extract", st.name, [&] {
+            i = nextFace(st, i + 1);
+            ex.extract(st.derolled[i].points, st.derolled[i].iod, v);
+            g_sink = v[features::featureIndex(features::BROW, features::ASYMMETRY)];
+        });
+    }
+
+    // The same measures one region at a time, each with its own loops.
+    for (const auto& st : streams) {
+        size_t i = 0;
+        r.run("features per-region passes", st.name, [&] {
+            i = nextFace(st, i + 1);
+            const auto& pts = st.derolled[i].points;
+            features::Measures m;
+            m[0] = pts[LM_LEFT_MOUTH_CORNER].y;
+            m[1] = pts[LM_RIGHT_MOUTH_CORNER].y;
+            float l = 0.f, rt = 0.f;
+            for (int k = LM_LEFT_BROW_START;  k <= LM_LEFT_BROW_END;  ++k) l  += pts[k].y;
+            for (int k = LM_RIGHT_BROW_START; k <= LM_RIGHT_BROW_END; ++k) rt += pts[k].y;
+            m[2] = l / 5.f;
+            m[3] = rt / 5.f;
+            const int eyes[2] = { LM_LEFT_EYE_START, LM_RIGHT_EYE_START };
+            for (int s = 0; s < 2; ++s) {
+                m[4 + s] = 0.5f * (pts[eyes[s] + 4].y + pts[eyes[s] + 5].y - pts[eyes[s] + 1].y - pts[eyes[s] + 2].y);
+            }
+            m[6] = pts[LM_LEFT_MOUTH_CORNER].y  - pts[LM_NOSE_BASE_START].y;
+            m[7] = pts[LM_RIGHT_MOUTH_CORNER].y - pts[LM_NOSE_BASE_END].y;
+            g_sink = m[2] - m[3];
+        });
+    }
+
+    for (const auto& st : streams) {
+        StabilityMonitor mon;
+        size_t i = 0;
+        r.run("StabilityMonitor::update", st.name, [&] {
+            i = (i + 1) % st.inputs.size();
+            const auto& in = st.inputs[i];
+            mon.update(in.faceCenter, in.iod, in.insideGuide, in.dt);
+            g_sink = mon.stableTime();
+        });
+    }
+
+    for (const auto& st : streams) {
+        SmileFlow flow;
+        flow.reset();
+        size_t i = 0;
+        r.run("SmileFlow::update", st.name, [&] {
+            if (++i == st.inputs.size()) { i = 0; flow.reset(); }
+            flow.update(st.inputs[i]);
+            g_sink = flow.smileIntensity();
+        });
+    }
+
+    // The same reporting metrics, which must stay in the noise.
+    for (const auto& st : streams) {
+        metrics::Registry registry;
+        SmileFlow flow;
+        flow.setMetrics(&registry, { { "station", "bench" } });
+        flow.reset();
+        size_t i = 0;
+        r.run("SmileFlow::update with metrics", st.name, [&] {
+            if (++i == st.inputs.size()) { i = 0; flow.reset(); }
+            flow.update(st.inputs[i]);
+            g_sink = flow.smileIntensity();
+        });
+    }
+
+    {
+        metrics::Registry registry;
+        metrics::Counter& c = registry.counter("bench_total", "");
+        metrics::Histogram& h = registry.histogram("bench_seconds", "", metrics::frameSecondsBounds());
+        double v = 0.0;
+        r.run("metrics::Counter::add", "one thread", [&] { c.add(); });
+        r.run("metrics::Histogram::observe", "one thread", [&] {
+            v = v < 0.5 ? v + 0.0137 : 0.0;
+            h.observe(v);
+        });
+        g_sink = (float)c.value();
+    }
+
+    // Snapshot the flow in each stage so uiLines() is measured per stage.
+    {
+        const auto& st = streams[synth::SMILE];
+        std::vector<SmileFlow> snapshots(SmileFlow::kNumStages);
+        std::vector<bool> have(SmileFlow::kNumStages, false);
+        SmileFlow flow;
+        snapshots[SmileFlow::STAGE_HOME] = flow;
+        have[SmileFlow::STAGE_HOME] = true;
+        flow.reset();
+        for (const auto& in : st.inputs) {
+            if (!have[flow.stage()]) { snapshots[flow.stage()] = flow; have[flow.stage()] = true; }
+            flow.update(in);
+        }
+        if (!have[flow.stage()]) { snapshots[flow.stage()] = flow; have[flow.stage()] = true; }
+        for (int s = 0; s < SmileFlow::kNumStages; ++s) {
+            if (!have[s]) continue;
+            const SmileFlow& snap = snapshots[s];
+            r.run("SmileFlow::uiLines", SmileFlow::stageName((SmileFlow::Stage)s), [&] {
+                g_sink = (float)snap.uiLines().size();
+            });
+        }
+    }
+}
+
+} // namespace
+
+bool writeJson(const std::string& path, const std::vector<Result>& results) {
+    ofJson arr = ofJson::array();
+    for (const auto& r : results) {
+        arr.push_back({
+            { "name",       r.name },
+            { "scenario",   r.scenario },
+            { "ns_per_op",  r.nsPerOp },
+            { "ns_min",     r.nsMin },
+            { "iterations", r.iterations }
+        });
+    }
+    return ofSavePrettyJson(path, ofJson{ { "results", arr } });
+}
+
+bool readJson(const std::string& path, std::vector<Result>& results) {
+    ofJson j = ofLoadJson(path);
+    if (!j.contains("results")) return false;
+    for (const auto& e : j["results"]) {
+        Result r;
+        r.name       = e.value("name", "");
+        r.scenario   = e.value("scenario", "");
+        r.nsPerOp    = e.value("ns_per_op", 0.0);
+        r.nsMin      = e.value("ns_min", 0.0);
+        r.iterations = e.value("iterations", (uint64_t)0);
+        results.push_back(r);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Runner runner;
+    std::string outPath = "bench.json";
+    std::string baselinePath;
+    double tolerance = 0.10;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if      (a == "--out")       outPath = value();
+        else if (a == "--baseline")  baselinePath = value();
+        else if (a == "--tolerance") tolerance = ofToDouble(value());
+        else if (a == "--min-time")  runner.minSeconds = ofToDouble(value());
+        else if (a == "--filter")    runner.filter = value();
+    }
+
+    runAll(runner);
+    if (!writeJson(outPath, runner.results)) {
+        ofLogError("bench") << "cannot write " << outPath;
+        return 1;
+    }
+    if (baselinePath.empty()) return 0;
+
+    std::vector<Result> baseline;
+    if (!readJson(baselinePath, baseline)) {
+        ofLogError("bench") << "cannot read baseline " << baselinePath;
+        return 1;
+    }
+    // Compare on the best repetition, which is the least noisy statistic.
+    int regressions = 0;
+    for (const auto& cur : runner.results) {
+        for (const auto& old : baseline) {
+            if (old.name != cur.name || old.scenario != cur.scenario || old.nsMin <= 0) continue;
+            double change = cur.nsMin / old.nsMin - 1.0;
+            if (change > tolerance) {
+                ofLogWarning("bench") << "REGRESSION " << cur.name << " [" << cur.scenario << "] +"
+                                      << ofToString(change * 100.0, 1) << "%";
+                regressions++;
+            }
+        }
+    }
+    return regressions > 0 ? 3 : 0;
+}
+
+} // namespace bench
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for the per-frame hot path, fed by synthetic landmark
+// streams so they run without a camera or dlib model.
+namespace bench {
+
+struct Result {
+    std::string name;
+    std::string scenario;
+    double   nsPerOp = 0; // median over repetitions
+    double   nsMin = 0;
+    uint64_t iterations = 0;
+};
+
+bool writeJson(const std::string& path, const std::vector<Result>& results);
+bool readJson(const std::string& path, std::vector<Result>& results);
+
+// Entry point for `--bench [--out r.json] [--baseline old.json] [--tolerance f]
+// [--min-time s] [--filter substr]`. Returns non-zero on a regression.
+int main(int argc, char* argv[]);
+
+} // namespace bench
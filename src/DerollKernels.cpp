@@ -0,0 +1,194 @@
+#include "DerollKernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define STROKE_KERNELS_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define STROKE_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace kernels {
+namespace {
+static_assert(LM_NUM_POINTS % 4 == 0, "kernels process four landmarks per step");
+static_assert(sizeof(glm::vec2) == 2 * sizeof(float), "LandmarkFrame points must be packed x,y floats");
+
+const float* raw(const LandmarkFrame& f) { return &f.points[0].x; }
+float*       raw(LandmarkFrame& f)       { return &f.points[0].x; }
+
+void finishEyes(glm::vec2 leftSum, glm::vec2 rightSum, DerollResult& r) {
+    r.leftEyeC  = leftSum  / float(LM_LEFT_EYE_END  - LM_LEFT_EYE_START  + 1);
+    r.rightEyeC = rightSum / float(LM_RIGHT_EYE_END - LM_RIGHT_EYE_START + 1);
+    r.center    = 0.5f * (r.leftEyeC + r.rightEyeC);
+    glm::vec2 d = r.rightEyeC - r.leftEyeC;
+    r.roll = std::atan2(d.y, d.x);
+}
+} // namespace
+
+void derollScalar(const LandmarkFrame& in, const guide::Oval& oval, LandmarkFrame& out, DerollResult& r) {
+    glm::vec2 ls(0,0), rs(0,0);
+    for (int i = LM_LEFT_EYE_START;  i <= LM_LEFT_EYE_END;  ++i) ls += in[i];
+    for (int i = LM_RIGHT_EYE_START; i <= LM_RIGHT_EYE_END; ++i) rs += in[i];
+    finishEyes(ls, rs, r);
+
+    const float cs = std::cos(-r.roll), sn = std::sin(-r.roll);
+    const glm::vec2 c = r.center;
+    int inside = 0;
+    for (int i = 0; i < LM_NUM_POINTS; ++i) {
+        glm::vec2 t = in[i] - c;
+        glm::vec2 p(cs * t.x - sn * t.y + c.x, sn * t.x + cs * t.y + c.y);
+        out[i] = p;
+        float nx = (p.x - oval.center.x) / oval.a;
+        float ny = (p.y - oval.center.y) / oval.b;
+        if (nx*nx + ny*ny <= 1.f) inside++;
+    }
+    out.frame = in.frame;
+    r.inside = inside;
+}
+
+int countInsideScalar(const LandmarkFrame& pts, const guide::Oval& oval) {
+    int inside = 0;
+    for (const auto& p : pts) {
+        float nx = (p.x - oval.center.x) / oval.a;
+        float ny = (p.y - oval.center.y) / oval.b;
+        if (nx*nx + ny*ny <= 1.f) inside++;
+    }
+    return inside;
+}
+
+#if STROKE_KERNELS_SSE2
+
+const char* isaName() { return "sse2"; }
+
+namespace {
+// (sum x, sum y) of the six consecutive points starting at p.
+glm::vec2 sum6(const float* p) {
+    __m128 s = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 8));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    alignas(16) float v[4];
+    _mm_store_ps(v, s);
+    return glm::vec2(v[0], v[1]);
+}
+
+inline int insideCount(__m128 x, __m128 y, __m128 ocx, __m128 ocy, __m128 oa, __m128 ob) {
+    static const int bits[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    __m128 nx = _mm_div_ps(_mm_sub_ps(x, ocx), oa);
+    __m128 ny = _mm_div_ps(_mm_sub_ps(y, ocy), ob);
+    __m128 d  = _mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny));
+    return bits[_mm_movemask_ps(_mm_cmple_ps(d, _mm_set1_ps(1.f)))];
+}
+} // namespace
+
+void deroll(const LandmarkFrame& in, const guide::Oval& oval, LandmarkFrame& out, DerollResult& r) {
+    const float* src = raw(in);
+    float*       dst = raw(out);
+    finishEyes(sum6(src + 2 * LM_LEFT_EYE_START), sum6(src + 2 * LM_RIGHT_EYE_START), r);
+
+    const __m128 cs  = _mm_set1_ps(std::cos(-r.roll));
+    const __m128 sn  = _mm_set1_ps(std::sin(-r.roll));
+    const __m128 cx  = _mm_set1_ps(r.center.x), cy = _mm_set1_ps(r.center.y);
+    const __m128 ocx = _mm_set1_ps(oval.center.x), ocy = _mm_set1_ps(oval.center.y);
+    const __m128 oa  = _mm_set1_ps(oval.a), ob = _mm_set1_ps(oval.b);
+    int inside = 0;
+    for (int i = 0; i < LM_NUM_POINTS; i += 4) {
+        __m128 a = _mm_loadu_ps(src + 2 * i);     // x0 y0 x1 y1
+        __m128 b = _mm_loadu_ps(src + 2 * i + 4); // x2 y2 x3 y3
+        __m128 tx = _mm_sub_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), cx);
+        __m128 ty = _mm_sub_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)), cy);
+        __m128 x = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(cs, tx), _mm_mul_ps(sn, ty)), cx);
+        __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sn, tx), _mm_mul_ps(cs, ty)), cy);
+        _mm_storeu_ps(dst + 2 * i,     _mm_unpacklo_ps(x, y));
+        _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(x, y));
+        inside += insideCount(x, y, ocx, ocy, oa, ob);
+    }
+    out.frame = in.frame;
+    r.inside = inside;
+}
+
+int countInside(const LandmarkFrame& pts, const guide::Oval& oval) {
+    const float* src = raw(pts);
+    const __m128 ocx = _mm_set1_ps(oval.center.x), ocy = _mm_set1_ps(oval.center.y);
+    const __m128 oa  = _mm_set1_ps(oval.a), ob = _mm_set1_ps(oval.b);
+    int inside = 0;
+    for (int i = 0; i < LM_NUM_POINTS; i += 4) {
+        __m128 a = _mm_loadu_ps(src + 2 * i);
+        __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+        __m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        inside += insideCount(x, y, ocx, ocy, oa, ob);
+    }
+    return inside;
+}
+
+#elif STROKE_KERNELS_NEON
+
+const char* isaName() { return "neon"; }
+
+namespace {
+glm::vec2 sum6(const float* p) {
+    float32x4_t s = vaddq_f32(vaddq_f32(vld1q_f32(p), vld1q_f32(p + 4)), vld1q_f32(p + 8));
+    float32x2_t h = vadd_f32(vget_low_f32(s), vget_high_f32(s));
+    return glm::vec2(vget_lane_f32(h, 0), vget_lane_f32(h, 1));
+}
+
+inline uint32_t insideCount(float32x4_t x, float32x4_t y, float32x4_t ocx, float32x4_t ocy,
+                            float32x4_t oa, float32x4_t ob) {
+    float32x4_t nx = vdivq_f32(vsubq_f32(x, ocx), oa);
+    float32x4_t ny = vdivq_f32(vsubq_f32(y, ocy), ob);
+    float32x4_t d  = vaddq_f32(vmulq_f32(nx, nx), vmulq_f32(ny, ny));
+    return vaddvq_u32(vshrq_n_u32(vcleq_f32(d, vdupq_n_f32(1.f)), 31));
+}
+} // namespace
+
+void deroll(const LandmarkFrame& in, const guide::Oval& oval, LandmarkFrame& out, DerollResult& r) {
+    const float* src = raw(in);
+    float*       dst = raw(out);
+    finishEyes(sum6(src + 2 * LM_LEFT_EYE_START), sum6(src + 2 * LM_RIGHT_EYE_START), r);
+
+    const float32x4_t cs  = vdupq_n_f32(std::cos(-r.roll));
+    const float32x4_t sn  = vdupq_n_f32(std::sin(-r.roll));
+    const float32x4_t cx  = vdupq_n_f32(r.center.x), cy = vdupq_n_f32(r.center.y);
+    const float32x4_t ocx = vdupq_n_f32(oval.center.x), ocy = vdupq_n_f32(oval.center.y);
+    const float32x4_t oa  = vdupq_n_f32(oval.a), ob = vdupq_n_f32(oval.b);
+    uint32_t inside = 0;
+    for (int i = 0; i < LM_NUM_POINTS; i += 4) {
+        float32x4x2_t p = vld2q_f32(src + 2 * i); // deinterleaves into x and y
+        float32x4_t tx = vsubq_f32(p.val[0], cx);
+        float32x4_t ty = vsubq_f32(p.val[1], cy);
+        float32x4x2_t q;
+        q.val[0] = vaddq_f32(vsubq_f32(vmulq_f32(cs, tx), vmulq_f32(sn, ty)), cx);
+        q.val[1] = vaddq_f32(vaddq_f32(vmulq_f32(sn, tx), vmulq_f32(cs, ty)), cy);
+        vst2q_f32(dst + 2 * i, q);
+        inside += insideCount(q.val[0], q.val[1], ocx, ocy, oa, ob);
+    }
+    out.frame = in.frame;
+    r.inside = (int)inside;
+}
+
+int countInside(const LandmarkFrame& pts, const guide::Oval& oval) {
+    const float* src = raw(pts);
+    const float32x4_t ocx = vdupq_n_f32(oval.center.x), ocy = vdupq_n_f32(oval.center.y);
+    const float32x4_t oa  = vdupq_n_f32(oval.a), ob = vdupq_n_f32(oval.b);
+    uint32_t inside = 0;
+    for (int i = 0; i < LM_NUM_POINTS; i += 4) {
+        float32x4x2_t p = vld2q_f32(src + 2 * i);
+        inside += insideCount(p.val[0], p.val[1], ocx, ocy, oa, ob);
+    }
+    return (int)inside;
+}
+
+#else
+
+const char* isaName() { return "scalar"; }
+
+void deroll(const LandmarkFrame& in, const guide::Oval& oval, LandmarkFrame& out, DerollResult& r) {
+    derollScalar(in, oval, out, r);
+}
+
+int countInside(const LandmarkFrame& pts, const guide::Oval& oval) {
+    return countInsideScalar(pts, oval);
+}
+
+#endif
+
+} // namespace kernels
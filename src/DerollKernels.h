@@ -0,0 +1,30 @@
+#pragma once
+#include "ofMain.h"
+#include "GuideOval.h"
+#include "LandmarkFrame.h"
+
+// Per-frame landmark geometry kernels. The points stay in the AoS
+// LandmarkFrame layout in memory; the SIMD paths (SSE2 on x86-64, NEON on
+// arm64) deinterleave four points at a time into x/y registers, so the
+// rotation and oval test run structure-of-arrays without a transpose pass.
+namespace kernels {
+
+const char* isaName(); // "sse2", "neon" or "scalar"
+
+struct DerollResult {
+    glm::vec2 leftEyeC{0,0};  // eye centroids before rotation
+    glm::vec2 rightEyeC{0,0};
+    glm::vec2 center{0,0};    // eye midpoint, the rotation center
+    float     roll = 0.f;
+    int       inside = 0;     // rotated points inside the oval
+};
+
+// Eye-centroid reduction, rotation about the eye midpoint by -roll and oval
+// containment of the rotated points, in a single sweep over the landmarks.
+void deroll(const LandmarkFrame& in, const guide::Oval& oval, LandmarkFrame& out, DerollResult& r);
+void derollScalar(const LandmarkFrame& in, const guide::Oval& oval, LandmarkFrame& out, DerollResult& r);
+
+int countInside(const LandmarkFrame& pts, const guide::Oval& oval);
+int countInsideScalar(const LandmarkFrame& pts, const guide::Oval& oval);
+
+} // namespace kernels
@@ -0,0 +1,228 @@
+#include "DetectorBenchmark.h"
+#include "ofMain.h"
+#include "FaceDetector.h"
+#include "FaceTrackerAdapter.h"
+#include "FrameSource.h"
+#include "Stats.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+namespace detectbench {
+namespace {
+
+// FaceTrackerAdapter's default detector image size.
+const float kDetectorPixels = 640.f * 480.f;
+
+// The whole frame as the tracker's detector sees it; returns the scale.
+float detectorImage(const Frame& frame, cv::Mat& gray, cv::Mat& small) {
+    cv::cvtColor(ofxCv::toCv(frame.pixels), gray, cv::COLOR_RGB2GRAY);
+    float scale = std::min(1.f, std::sqrt(kDetectorPixels / (float(gray.cols) * gray.rows)));
+    if (scale < 1.f) cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+    else             small = gray;
+    return scale;
+}
+
+// HOG over each whole frame of clip; boxes in frame coordinates.
+bool referenceBoxes(const std::string& clip, double fps, std::vector<std::vector<ofRectangle>>& out) {
+    auto src = frames::open(clip, fps);
+    if (!src) return false;
+    HogFaceDetector hog;
+    Frame frame;
+    cv::Mat gray, small;
+    std::vector<cv::Rect> found;
+    out.clear();
+    while (src->next(frame)) {
+        float scale = detectorImage(frame, gray, small);
+        hog.detect(small, nullptr, found);
+        out.emplace_back();
+        for (const auto& r : found) {
+            out.back().emplace_back(r.x / scale, r.y / scale, r.width / scale, r.height / scale);
+        }
+    }
+    return true;
+}
+
+Row runBackend(const std::string& clip, double fps, const std::string& name,
+               std::shared_ptr<const LandmarkModel> model, const std::vector<std::vector<ofRectangle>>& reference) {
+    Row row;
+    row.clip = clip;
+    row.detector = name;
+    auto detector = detectors::make(name);
+    auto src = frames::open(clip, fps);
+    if (!detector || !src) return row;
+
+    FaceTrackerAdapter tracker;
+    tracker.setDetector(std::move(detector));
+    tracker.setup(std::move(model));
+    Frame frame;
+    while (row.frames < reference.size() && src->next(frame)) {
+        FaceTrackerAdapter::DetectionStats before = tracker.detectionStats();
+        tracker.update(frame.pixels);
+        const FaceTrackerAdapter::DetectionStats& after = tracker.detectionStats();
+        if (after.searches > before.searches) {
+            row.searches++;
+            row.detectSeconds.push_back(after.seconds - before.seconds);
+        }
+
+        const auto& ref = reference[row.frames++];
+        if (ref.empty()) {
+            if (tracker.hasFace()) row.extraFrames++;
+            continue;
+        }
+        row.referenceFrames++;
+        if (!tracker.hasFace()) continue;
+        glm::vec2 c(tracker.faces().front().box.getCenter());
+        for (const auto& r : ref) {
+            if (r.inside(c.x, c.y)) {
+                row.hits++;
+                break;
+            }
+        }
+    }
+    return row;
+}
+
+// Same faces: every box has a partner in the other set with IoU >= 0.9.
+bool sameBoxes(const std::vector<cv::Rect>& a, const std::vector<cv::Rect>& b) {
+    if (a.size() != b.size()) return false;
+    for (const auto& r : a) {
+        bool matched = std::any_of(b.begin(), b.end(), [&](const cv::Rect& s) {
+            double overlap = (r & s).area();
+            return overlap >= 0.9 * (r.area() + s.area() - overlap);
+        });
+        if (!matched) return false;
+    }
+    return true;
+}
+
+// Serial HOG against SplitHogFaceDetector at each thread count, on the
+// whole of every frame: latency, speedup and frames whose faces differ.
+void splitSweep(const std::vector<std::string>& clips, double fps, const std::vector<int>& threads) {
+    HogFaceDetector serial;
+    std::vector<std::unique_ptr<SplitHogFaceDetector>> split;
+    for (int n : threads) split.push_back(std::make_unique<SplitHogFaceDetector>(n));
+    std::vector<double> serialSeconds;
+    std::vector<std::vector<double>> splitSeconds(threads.size());
+    std::vector<size_t> differ(threads.size(), 0);
+
+    auto timed = [](FaceDetector& d, const cv::Mat& img, std::vector<cv::Rect>& boxes) {
+        auto t0 = std::chrono::steady_clock::now();
+        d.detect(img, nullptr, boxes);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    };
+    Frame frame;
+    cv::Mat gray, small;
+    std::vector<cv::Rect> expected, found;
+    for (const auto& clip : clips) {
+        auto src = frames::open(clip, fps);
+        if (!src) continue;
+        while (src->next(frame)) {
+            detectorImage(frame, gray, small);
+            serialSeconds.push_back(timed(serial, small, expected));
+            for (size_t t = 0; t < split.size(); ++t) {
+                splitSeconds[t].push_back(timed(*split[t], small, found));
+                if (!sameBoxes(expected, found)) differ[t]++;
+            }
+        }
+    }
+    const double serialP50 = stats::percentile(serialSeconds, 0.5);
+    ofLogNotice("detect-bench") << "hog: p50 " << ofToString(serialP50 * 1000.0, 2) << " ms over "
+                                << serialSeconds.size() << " frames";
+    for (size_t t = 0; t < split.size(); ++t) {
+        const double p50 = stats::percentile(splitSeconds[t], 0.5);
+        ofLogNotice("detect-bench") << split[t]->name() << ": p50 " << ofToString(p50 * 1000.0, 2) << " ms, p95 "
+                                    << ofToString(stats::percentile(splitSeconds[t], 0.95) * 1000.0, 2) << " ms, speedup "
+                                    << ofToString(p50 > 0.0 ? serialP50 / p50 : 0.0, 2) << "x, " << differ[t]
+                                    << " frames differ from hog";
+    }
+}
+
+} // namespace
+
+bool writeCsv(const std::string& path, const std::vector<Row>& rows) {
+    std::ofstream out(ofToDataPath(path, true));
+    if (!out) return false;
+    out << "clip,detector,frames,reference_frames,hits,recall,extra_frames,searches,"
+           "detect_ms_mean,detect_ms_p50,detect_ms_p95\n";
+    for (const auto& r : rows) {
+        double sum = 0.0;
+        for (double s : r.detectSeconds) sum += s;
+        double mean = r.detectSeconds.empty() ? 0.0 : sum / r.detectSeconds.size();
+        out << '"' << r.clip << '"' << "," << r.detector << "," << r.frames << "," << r.referenceFrames << ","
+            << r.hits << "," << r.recall() << "," << r.extraFrames << "," << r.searches << ","
+            << mean * 1000.0 << "," << stats::percentile(r.detectSeconds, 0.5) * 1000.0 << ","
+            << stats::percentile(r.detectSeconds, 0.95) * 1000.0 << "\n";
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string modelPath = "model/shape_predictor_68_face_landmarks.dat";
+    std::string csvPath = "detectors.csv";
+    std::vector<std::string> names{ "hog", "haar", "reuse" };
+    double fps = 30.0;
+    std::vector<int> threads;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if      (a == "--model")     modelPath = value();
+        else if (a == "--csv")       csvPath = value();
+        else if (a == "--detectors") names = ofSplitString(value(), ",", true, true);
+        else if (a == "--fps")       fps = ofToDouble(value());
+        else if (a == "--threads") {
+            for (const auto& n : ofSplitString(value(), ",", true, true)) threads.push_back(std::max(1, ofToInt(n)));
+        }
+        else inputs.push_back(a);
+    }
+
+    auto clips = frames::collectClips(inputs);
+    if (clips.empty() || names.empty()) {
+        ofLogError("detect-bench") << "usage: --detect-bench [--model p] [--detectors hog,haar,reuse] [--fps n] "
+                                      "[--csv out.csv] [--threads 2,4,...] <clip|dir>...";
+        return 2;
+    }
+    auto model = LandmarkModel::shared(modelPath);
+    if (!model) return 1;
+
+    std::vector<Row> rows, totals(names.size());
+    for (size_t d = 0; d < names.size(); ++d) {
+        totals[d].clip = "*";
+        totals[d].detector = names[d];
+    }
+    std::vector<std::vector<ofRectangle>> reference;
+    for (const auto& clip : clips) {
+        if (!referenceBoxes(clip, fps, reference)) {
+            ofLogWarning("detect-bench") << "cannot open " << clip;
+            continue;
+        }
+        for (size_t d = 0; d < names.size(); ++d) {
+            Row r = runBackend(clip, fps, names[d], model, reference);
+            Row& t = totals[d];
+            t.frames          += r.frames;
+            t.referenceFrames += r.referenceFrames;
+            t.hits            += r.hits;
+            t.extraFrames     += r.extraFrames;
+            t.searches        += r.searches;
+            t.detectSeconds.insert(t.detectSeconds.end(), r.detectSeconds.begin(), r.detectSeconds.end());
+            rows.push_back(std::move(r));
+        }
+    }
+    for (const auto& t : totals) {
+        ofLogNotice("detect-bench") << t.detector << ": recall " << ofToString(t.recall(), 3) << " over "
+                                    << t.referenceFrames << " frames, " << t.extraFrames << " extra, p50 "
+                                    << ofToString(stats::percentile(t.detectSeconds, 0.5) * 1000.0, 2) << " ms, p95 "
+                                    << ofToString(stats::percentile(t.detectSeconds, 0.95) * 1000.0, 2) << " ms";
+    }
+    if (!threads.empty()) splitSweep(clips, fps, threads);
+    rows.insert(rows.end(), totals.begin(), totals.end());
+    if (!writeCsv(csvPath, rows)) {
+        ofLogError("detect-bench") << "cannot write " << csvPath;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace detectbench
@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Compares face-detector backends on recorded clips. The reference for each
+// frame is HOG over the whole frame; every backend then runs inside a
+// FaceTrackerAdapter, as it would live, and is scored on how often its
+// tracked face lands in a reference box and on what detection costs.
+namespace detectbench {
+
+struct Row {
+    std::string clip;          // "*" for the total over all clips
+    std::string detector;
+    size_t frames = 0;
+    size_t referenceFrames = 0; // frames where the reference found a face
+    size_t hits = 0;            // ... and the backend tracked a face inside a reference box
+    size_t extraFrames = 0;     // backend reported a face the reference did not
+    size_t searches = 0;
+    std::vector<double> detectSeconds; // one entry per search
+
+    double recall() const { return referenceFrames ? double(hits) / referenceFrames : 0.0; }
+};
+
+bool writeCsv(const std::string& path, const std::vector<Row>& rows);
+
+// Entry point for `--detect-bench [--model p] [--detectors hog,haar,reuse]
+// [--fps n] [--csv out.csv] [--threads 2,4,...] <clip|dir>...`. --threads
+// also times HOG split across each number of threads against serial HOG.
+// Returns the exit code.
+int main(int argc, char* argv[]);
+
+} // namespace detectbench
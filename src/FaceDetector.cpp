@@ -0,0 +1,169 @@
+#include "FaceDetector.h"
+#include <dlib/opencv.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Levels a part scans at most when it is not the last; the last scans to
+// the top of the pyramid.
+const unsigned long kAllLevels = 1000;
+
+// First pyramid level of each of n parts. Each level has (5/6)^2 of the
+// pixels of the one below; the boundaries split that geometric series
+// into runs of about equal cost.
+std::vector<unsigned long> splitLevels(int n) {
+    const double r = 25.0 / 36.0, total = 1.0 / (1.0 - r);
+    std::vector<unsigned long> first{ 0 };
+    double cost = 0.0, level = 1.0;
+    for (unsigned long l = 0; (int)first.size() < n; ++l, level *= r) {
+        cost += level;
+        // Cut after level l when that lands closer to the target than not.
+        if (cost >= total * first.size() / n - 0.5 * level) first.push_back(l + 1);
+    }
+    return first;
+}
+
+} // namespace
+
+HogFaceDetector::HogFaceDetector() : detector_(dlib::get_frontal_face_detector()) {}
+
+void HogFaceDetector::detect(const cv::Mat& gray, const cv::Rect*, std::vector<cv::Rect>& boxes) {
+    boxes.clear();
+    dlib::cv_image<unsigned char> img(gray);
+    for (const auto& r : detector_(img)) {
+        boxes.emplace_back((int)r.left(), (int)r.top(), (int)r.width(), (int)r.height());
+    }
+}
+
+SplitHogFaceDetector::SplitHogFaceDetector(int threads)
+    : name_("hog:" + ofToString(std::max(1, threads))), pool_(std::max(1, threads)) {
+    const dlib::frontal_face_detector base = dlib::get_frontal_face_detector();
+    overlap_ = base.get_overlap_tester();
+    minLevelWidth_ = (long)base.get_scanner().get_min_pyramid_layer_width();
+    minLevelHeight_ = (long)base.get_scanner().get_min_pyramid_layer_height();
+    std::vector<dlib::frontal_face_detector::feature_vector_type> weights;
+    for (unsigned long i = 0; i < base.num_detectors(); ++i) weights.push_back(base.get_w(i));
+
+    const std::vector<unsigned long> first = splitLevels(std::max(1, threads));
+    parts_.resize(first.size());
+    for (size_t p = 0; p < first.size(); ++p) {
+        auto scanner = base.get_scanner();
+        scanner.set_max_pyramid_levels(p + 1 < first.size() ? first[p + 1] - first[p] : kAllLevels);
+        parts_[p].firstLevel = first[p];
+        // Thresholds no overlap can exceed: suppression waits for the merge.
+        parts_[p].detector = dlib::frontal_face_detector(scanner, dlib::test_box_overlap(1.0, 1.0), weights);
+    }
+    levels_.resize(first.back() + 1);
+}
+
+void SplitHogFaceDetector::detect(const cv::Mat& gray, const cv::Rect*, std::vector<cv::Rect>& boxes) {
+    boxes.clear();
+    if (gray.empty()) return;
+    // The levels parts start from, built the way the scanner builds its own.
+    dlib::cv_image<unsigned char> img(gray);
+    dlib::pyramid_down<6> pyr;
+    size_t built = 1;
+    for (size_t l = 1; l < levels_.size(); ++l, ++built) {
+        if (l == 1) pyr(img, levels_[l]);
+        else        pyr(levels_[l - 1], levels_[l]);
+        if (levels_[l].nc() < minLevelWidth_ || levels_[l].nr() < minLevelHeight_) break;
+    }
+
+    pool_.run(parts_.size(), [&](size_t, size_t p) {
+        Part& part = parts_[p];
+        part.found.clear();
+        if (part.firstLevel == 0)          part.detector(img, part.found);
+        else if (part.firstLevel < built)  part.detector(levels_[part.firstLevel], part.found);
+    });
+
+    // As object_detector suppresses: strongest first, dropping any box that
+    // overlaps one already kept.
+    merged_.clear();
+    for (const Part& part : parts_) {
+        for (dlib::rect_detection d : part.found) {
+            d.rect = pyr.rect_up(dlib::drectangle(d.rect), (unsigned int)part.firstLevel);
+            merged_.push_back(d);
+        }
+    }
+    std::sort(merged_.begin(), merged_.end(), [](const dlib::rect_detection& a, const dlib::rect_detection& b) {
+        return a.detection_confidence > b.detection_confidence;
+    });
+    std::vector<dlib::rectangle> kept;
+    for (const auto& d : merged_) {
+        bool overlaps = std::any_of(kept.begin(), kept.end(), [&](const dlib::rectangle& k) { return overlap_(d.rect, k); });
+        if (overlaps) continue;
+        kept.push_back(d.rect);
+        boxes.emplace_back((int)d.rect.left(), (int)d.rect.top(), (int)d.rect.width(), (int)d.rect.height());
+    }
+}
+
+bool HaarFaceDetector::load(const std::string& cascadePath) {
+    if (!cascade_.load(ofToDataPath(cascadePath, true))) {
+        ofLogError("HaarFaceDetector") << "cannot load cascade " << cascadePath;
+        return false;
+    }
+    return true;
+}
+
+void HaarFaceDetector::detect(const cv::Mat& gray, const cv::Rect*, std::vector<cv::Rect>& boxes) {
+    boxes.clear();
+    if (cascade_.empty() || gray.empty()) return;
+    cv::equalizeHist(gray, equalized_);
+    int minSide = std::max(1, (int)std::lround(minFaceFraction * std::min(gray.cols, gray.rows)));
+    cascade_.detectMultiScale(equalized_, found_, scaleFactor, minNeighbors, 0, cv::Size(minSide, minSide));
+    for (const auto& f : found_) {
+        float w = f.width * boxScale, h = f.height * boxScale;
+        float cx = f.x + 0.5f * f.width;
+        float cy = f.y + 0.5f * f.height + boxShiftY * f.height;
+        boxes.emplace_back(std::lround(cx - 0.5f * w), std::lround(cy - 0.5f * h), std::lround(w), std::lround(h));
+    }
+}
+
+ReuseLastBoxDetector::ReuseLastBoxDetector(std::unique_ptr<FaceDetector> fallback, int maxReuse)
+    : fallback_(std::move(fallback)), name_(std::string("reuse:") + fallback_->name()), maxReuse_(maxReuse) {}
+
+void ReuseLastBoxDetector::detect(const cv::Mat& gray, const cv::Rect* hint, std::vector<cv::Rect>& boxes) {
+    if (hint && reused_ < maxReuse_) {
+        boxes.assign(1, *hint);
+        reused_++;
+        return;
+    }
+    reused_ = 0;
+    fallback_->detect(gray, hint, boxes);
+}
+
+void ReuseLastBoxDetector::reset() {
+    reused_ = 0;
+    fallback_->reset();
+}
+
+namespace detectors {
+
+const char* const kHaarCascadePath = "models/haarcascade_frontalface_default.xml";
+
+std::unique_ptr<FaceDetector> make(const std::string& name, const std::string& haarCascadePath) {
+    if (name == "hog") return std::make_unique<HogFaceDetector>();
+    if (name.compare(0, 4, "hog:") == 0) {
+        int threads = ofToInt(name.substr(4));
+        if (threads > 1) return std::make_unique<SplitHogFaceDetector>(threads);
+        if (threads == 1) return std::make_unique<HogFaceDetector>();
+        ofLogError("detectors") << name << ": hog:N needs a thread count of at least 1";
+        return nullptr;
+    }
+    if (name == "haar") {
+        auto haar = std::make_unique<HaarFaceDetector>();
+        if (!haar->load(haarCascadePath)) return nullptr;
+        return haar;
+    }
+    if (name == "reuse") return make("reuse:hog", haarCascadePath);
+    if (name.compare(0, 6, "reuse:") == 0) {
+        auto fallback = make(name.substr(6), haarCascadePath);
+        if (!fallback) return nullptr;
+        return std::make_unique<ReuseLastBoxDetector>(std::move(fallback));
+    }
+    ofLogError("detectors") << "unknown face detector " << name;
+    return nullptr;
+}
+
+} // namespace detectors
@@ -0,0 +1,105 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxCv.h"
+#include <dlib/image_processing/frontal_face_detector.h>
+#include "WorkStealingPool.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Finds faces for FaceTrackerAdapter. The tracker hands over an 8-bit
+// grayscale image that is already cropped to its search region and scaled
+// down; boxes come back in that image's coordinates.
+class FaceDetector {
+public:
+    virtual ~FaceDetector() = default;
+    virtual const char* name() const = 0;
+    // hint is where the tracked face is now, in gray's coordinates, or null
+    // when no face is locked.
+    virtual void detect(const cv::Mat& gray, const cv::Rect* hint, std::vector<cv::Rect>& boxes) = 0;
+    // Forget any state carried between frames, e.g. between clips.
+    virtual void reset() {}
+};
+
+// dlib's HOG frontal face detector; the boxes the shape predictor was trained on.
+class HogFaceDetector : public FaceDetector {
+public:
+    HogFaceDetector();
+    const char* name() const override { return "hog"; }
+    void detect(const cv::Mat& gray, const cv::Rect* hint, std::vector<cv::Rect>& boxes) override;
+private:
+    dlib::frontal_face_detector detector_;
+};
+
+// The HOG detector with one frame's image pyramid split across threads:
+// each thread scans a run of consecutive levels with its own copy of the
+// detector, and the raw detections are merged with the detector's own
+// non-maximum suppression, so the faces are the serial detector's to within
+// a pixel of pyramid rounding. Levels shrink by 5/6 a side, so level 0 is
+// nearly a third of the work and bounds the speedup at about 3.3x; past
+// four threads there is little left to gain.
+class SplitHogFaceDetector : public FaceDetector {
+public:
+    explicit SplitHogFaceDetector(int threads);
+    const char* name() const override { return name_.c_str(); }
+    void detect(const cv::Mat& gray, const cv::Rect* hint, std::vector<cv::Rect>& boxes) override;
+private:
+    struct Part {
+        unsigned long firstLevel = 0;
+        dlib::frontal_face_detector detector;   // scans from firstLevel on, no suppression
+        std::vector<dlib::rect_detection> found; // firstLevel's coordinates
+    };
+    std::string name_;
+    std::vector<Part> parts_;
+    std::vector<dlib::array2d<unsigned char>> levels_; // levels_[l]: pyramid level l, l >= 1
+    std::vector<dlib::rect_detection> merged_;
+    dlib::test_box_overlap overlap_;
+    long minLevelWidth_ = 0, minLevelHeight_ = 0;
+    WorkStealingPool pool_;
+};
+
+// OpenCV Haar cascade. Much cheaper than HOG, but its boxes sit higher and
+// are larger than HOG's, so each one is mapped onto the HOG framing the
+// shape predictor expects.
+class HaarFaceDetector : public FaceDetector {
+public:
+    float scaleFactor = 1.1f;
+    int   minNeighbors = 4;
+    float minFaceFraction = 0.15f; // smallest face, relative to the image's shorter side
+    float boxScale = 0.85f;        // Haar box -> HOG box, about the box center
+    float boxShiftY = 0.08f;       // ... then moved down by this fraction of the height
+
+    bool load(const std::string& cascadePath);
+    const char* name() const override { return "haar"; }
+    void detect(const cv::Mat& gray, const cv::Rect* hint, std::vector<cv::Rect>& boxes) override;
+private:
+    cv::CascadeClassifier cascade_;
+    cv::Mat equalized_;
+    std::vector<cv::Rect> found_;
+};
+
+// Skips detection while a face is locked: the hint (the square around the
+// last landmarks) is returned as the box and the shape predictor re-fits
+// inside it. Every maxReuse frames, and whenever the lock is lost, the
+// wrapped detector runs instead, so a drifting box is corrected.
+class ReuseLastBoxDetector : public FaceDetector {
+public:
+    explicit ReuseLastBoxDetector(std::unique_ptr<FaceDetector> fallback, int maxReuse = 10);
+    const char* name() const override { return name_.c_str(); }
+    void detect(const cv::Mat& gray, const cv::Rect* hint, std::vector<cv::Rect>& boxes) override;
+    void reset() override;
+private:
+    std::unique_ptr<FaceDetector> fallback_;
+    std::string name_;
+    int maxReuse_;
+    int reused_ = 0;
+};
+
+namespace detectors {
+// Default location of the bundled cascade, relative to the data folder.
+extern const char* const kHaarCascadePath;
+// "hog", "hog:<threads>" (SplitHogFaceDetector), "haar", "reuse" (reuse
+// over hog) or "reuse:<name>". Returns null for an unknown name or a
+// cascade that does not load.
+std::unique_ptr<FaceDetector> make(const std::string& name, const std::string& haarCascadePath = kHaarCascadePath);
+} // namespace detectors
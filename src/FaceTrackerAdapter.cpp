@@ -1,50 +1,377 @@
 #include "FaceTrackerAdapter.h"
+#include <dlib/opencv.h>
+#include "DerollKernels.h"
+#include "Profiler.h"
+#include <chrono>
+
+namespace {
+ofRectangle padded(const ofRectangle& r, float fraction) {
+    return ofRectangle(r.x - r.width * fraction, r.y - r.height * fraction,
+                       r.width * (1.f + 2.f * fraction), r.height * (1.f + 2.f * fraction));
+}
+
+float overlap(const ofRectangle& a, const ofRectangle& b) {
+    float i = a.getIntersection(b).getArea();
+    float u = a.getArea() + b.getArea() - i;
+    return u > 0.f ? i / u : 0.f;
+}
+
+// Share of r inside the oval, sampled on a grid.
+float insideShare(const ofRectangle& r, const guide::Oval& o) {
+    const int kSteps = 6;
+    int inside = 0;
+    for (int y = 0; y < kSteps; ++y) {
+        for (int x = 0; x < kSteps; ++x) {
+            float dx = (r.x + (x + 0.5f) * r.width / kSteps - o.center.x) / o.a;
+            float dy = (r.y + (y + 0.5f) * r.height / kSteps - o.center.y) / o.b;
+            if (dx * dx + dy * dy <= 1.f) inside++;
+        }
+    }
+    return float(inside) / (kSteps * kSteps);
+}
+} // namespace
 
 void FaceTrackerAdapter::setup(const std::string& modelPath) {
-    tracker_.setup(modelPath);
+    setup(LandmarkModel::shared(modelPath));
 }
 
-void FaceTrackerAdapter::update(ofVideoGrabber& grabber) {
-    if (grabber.isFrameNew()) tracker_.update(grabber);
+void FaceTrackerAdapter::setup(std::shared_ptr<const LandmarkModel> model) {
+    model_ = std::move(model);
+    if (!detector_) detector_ = std::make_unique<HogFaceDetector>();
+    reset();
 }
 
-bool FaceTrackerAdapter::hasFace() const {
-    return !tracker_.getInstances().empty();
+void FaceTrackerAdapter::update(ofPixels& frame) {
+    if (!metrics_) {
+        track(frame, faces_);
+        return;
+    }
+    Metrics& m = *metrics_;
+    const uint64_t searches = stats_.searches;
+    auto t0 = std::chrono::steady_clock::now();
+    track(frame, faces_);
+    m.seconds->observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    m.frames->add();
+    m.searches->add(stats_.searches - searches);
+    if (!measured_) {
+        if (metrics::Counter* c = m.gated[gate_.lastVerdict()]) c->add();
+        return;
+    }
+    const bool face = !faces_.empty();
+    if (face) m.faceFrames->add();
+    if (face && faces_.front().predicted) m.predicted->add();
+    if (m.hadFace && !face) m.facesLost->add();
+    if (face && subject() != m.lastSubject) m.subjects->add();
+    m.hadFace = face;
+    if (face) m.lastSubject = subject();
 }
 
-bool FaceTrackerAdapter::getDerolled(DerolledData& out) const {
-    out = DerolledData{};
-    const auto& instances = tracker_.getInstances();
-    if (instances.empty()) return false;
-
-    auto& inst = const_cast<ofxFaceTracker2Instance&>(instances.front());
-    auto& lms  = inst.getLandmarks();
-    auto pts   = lms.getImagePoints();
-
-    auto meanRange = [&](int a, int b) {
-        glm::vec2 m(0,0);
-        int cnt = 0;
-        for (int i = a; i <= b; ++i) { m += pts[i]; ++cnt; }
-        if (cnt > 0) m /= (float)cnt;
-        return m;
-    };
+FaceTrackerAdapter::Metrics::Metrics(metrics::Registry& r, const metrics::Labels& labels)
+    : seconds(&r.histogram("stroke_tracker_seconds", "Time to track one frame.", metrics::frameSecondsBounds(), labels)),
+      frames(&r.counter("stroke_tracker_frames_total", "Frames passed to the face tracker.", labels)),
+      faceFrames(&r.counter("stroke_tracker_face_frames_total", "Tracked frames with a face.", labels)),
+      predicted(&r.counter("stroke_tracker_predicted_frames_total", "Frames whose landmarks were extrapolated.", labels)),
+      facesLost(&r.counter("stroke_tracker_faces_lost_total", "Times a tracked face was lost.", labels)),
+      searches(&r.counter("stroke_tracker_detections_total", "Face detector runs.", labels)),
+      subjects(&r.counter("stroke_tracker_subjects_total", "Distinct people followed in turn.", labels)) {
+    for (int v = FrameGate::DARK; v <= FrameGate::BLURRY; ++v) {
+        metrics::Labels l = labels;
+        l.emplace_back("reason", FrameGate::verdictName(FrameGate::Verdict(v)));
+        gated[v] = &r.counter("stroke_tracker_gated_frames_total", "Frames rejected as too poor to track.", l);
+    }
+}
+
+void FaceTrackerAdapter::setMetrics(metrics::Registry* r, const metrics::Labels& labels) {
+    metrics_.reset(r ? new Metrics(*r, labels) : nullptr);
+}
 
-    glm::vec2 leftEyeC  = meanRange(LM_LEFT_EYE_START,  LM_LEFT_EYE_END);
-    glm::vec2 rightEyeC = meanRange(LM_RIGHT_EYE_START, LM_RIGHT_EYE_END);
-    glm::vec2 center    = 0.5f * (leftEyeC + rightEyeC);
+void FaceTrackerAdapter::reset() {
+    faces_.clear();
+    haveLastFace_ = false;
+    misses_ = 0;
+    subject_ = 0;
+    subjectMisses_ = 0;
+    measured_ = true;
+    predictor_.reset();
+    gate_.reset();
+    if (detector_) detector_->reset();
+}
 
-    glm::vec2 d = rightEyeC - leftEyeC;
-    float roll = std::atan2(d.y, d.x);
+// In work_ coordinates.
+cv::Rect FaceTrackerAdapter::searchRegion() const {
+    cv::Rect full(0, 0, work_.cols, work_.rows);
+    if (!policy_.useRoi) return full;
 
-    out.points.resize(pts.size());
-    for (size_t i = 0; i < pts.size(); ++i) {
-        out.points[i] = math2d::rotateAround(pts[i], center, -roll);
+    ofRectangle r;
+    if (haveLastFace_) {
+        r = padded(lastFace_, policy_.facePadding);
+    } else if (misses_ < policy_.fullFrameEvery) {
+        const guide::Oval& o = geometry_.oval;
+        r = padded(ofRectangle(o.center.x - o.a, o.center.y - o.b, 2.f * o.a, 2.f * o.b), policy_.ovalPadding);
+    } else {
+        return full;
     }
-    out.leftEyeC   = math2d::rotateAround(leftEyeC,  center, -roll);
-    out.rightEyeC  = math2d::rotateAround(rightEyeC, center, -roll);
-    out.faceCenter = center;
-    out.iod        = math2d::interOcular(out.leftEyeC, out.rightEyeC);
-    out.insideGuide = guide::mostlyInsideGuide(out.points);
+    const float s = trackScale_;
+    cv::Rect crop = cv::Rect(std::lround(r.x * s), std::lround(r.y * s),
+                             std::lround(r.width * s), std::lround(r.height * s)) & full;
+    return crop.area() > 0 ? crop : full;
+}
+
+void FaceTrackerAdapter::detect(ofPixels& frame, std::vector<dlib::rectangle>& boxes) {
+    PROFILE_SCOPE(prof::DETECT);
+    auto t0 = std::chrono::steady_clock::now();
+    cv::Mat src = ofxCv::toCv(frame);
+    if (src.channels() == 1) gray_ = src;
+    else cv::cvtColor(src, gray_, src.channels() == 4 ? cv::COLOR_RGBA2GRAY : cv::COLOR_RGB2GRAY);
+    if (trackScale_ < 1.f) cv::resize(gray_, work_, cv::Size(), trackScale_, trackScale_, cv::INTER_AREA);
+    else                   work_ = gray_;
+
+    // Detector pixels per work_ pixel. It comes from the full frame, so a face
+    // is the same size to the detector whatever the crop or tracking scale.
+    float scale = 1.f;
+    float area = (float)gray_.cols * gray_.rows;
+    if (detectorPixels_ > 0 && area > detectorPixels_) scale = std::min(1.f, std::sqrt(detectorPixels_ / area) / trackScale_);
+
+    cv::Rect roi = searchRegion();
+    fullFrameSearch_ = roi.area() == work_.cols * work_.rows;
+    cv::Mat crop = work_(roi);
+    if (scale < 1.f) cv::resize(crop, small_, cv::Size(), scale, scale, cv::INTER_AREA);
+    else             small_ = crop;
+
+    // The square around the last landmarks, in small_ coordinates.
+    cv::Rect hintBox;
+    if (haveLastFace_) {
+        float side = std::max(lastFace_.width, lastFace_.height) * trackScale_ * scale;
+        glm::vec2 c = (glm::vec2(lastFace_.getCenter()) * trackScale_ - glm::vec2(roi.x, roi.y)) * scale;
+        hintBox = cv::Rect(std::lround(c.x - 0.5f * side), std::lround(c.y - 0.5f * side),
+                           std::lround(side), std::lround(side));
+    }
+    detector_->detect(small_, haveLastFace_ ? &hintBox : nullptr, found_);
+    boxes.clear();
+    for (const auto& r : found_) {
+        boxes.emplace_back(roi.x + std::lround(r.x / scale), roi.y + std::lround(r.y / scale),
+                           roi.x + std::lround((r.x + r.width - 1) / scale),
+                           roi.y + std::lround((r.y + r.height - 1) / scale));
+    }
+
+    stats_.searches++;
+    if (fullFrameSearch_) stats_.fullFrameSearches++;
+    stats_.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void FaceTrackerAdapter::track(ofPixels& frame, std::vector<TrackedFace>& out) {
+    if (!model_ || !frame.isAllocated()) {
+        out.clear();
+        return;
+    }
+    if ((int)frame.getWidth() != geometry_.frameWidth || (int)frame.getHeight() != geometry_.frameHeight) {
+        geometry_ = guide::geometryFor((int)frame.getWidth(), (int)frame.getHeight());
+        haveLastFace_ = false;
+        out.clear();
+    }
+
+    uint64_t index = frameCount_++;
+    measured_ = true;
+    if (gate_.settings().enabled) {
+        const guide::Oval& o = geometry_.oval;
+        ofRectangle region(o.center.x - o.a, o.center.y - o.b, 2.f * o.a, 2.f * o.b);
+        if (!gate_.admit(ofxCv::toCv(frame), region)) {
+            // out keeps the last measured face.
+            measured_ = false;
+            return;
+        }
+    }
+    out.clear();
+    if (canPredict(frame)) {
+        TrackedFace face;
+        face.predicted = true;
+        face.points.frame = index;
+        glm::vec2 before(lastFace_.getCenter());
+        predictor_.predict(face.points);
+        lockOnto(face.points);
+        glm::vec2 moved = glm::vec2(lastFace_.getCenter()) - before;
+        face.box = lastBox_;
+        face.box.translate(moved.x, moved.y);
+        face.subject = subject_;
+        lastBox_ = face.box;
+        out.push_back(face);
+        predictedFrames_++;
+        return;
+    }
+
+    detect(frame, boxes_);
+
+    // Landmarks are fitted on work_, for the subject alone, and reported in
+    // frame coordinates.
+    PROFILE_SCOPE(prof::LANDMARK);
+    const float toFrame = 1.f / trackScale_;
+    bool same = false;
+    int chosen = selectSubject(boxes_, same);
+    if (chosen >= 0) {
+        const dlib::rectangle& box = boxes_[chosen];
+        TrackedFace face;
+        model_->fit(work_, box, face.points);
+        face.box = ofRectangle(box.left() * toFrame, box.top() * toFrame,
+                               box.width() * toFrame, box.height() * toFrame);
+        face.points.frame = index;
+        for (auto& p : face.points) p *= toFrame;
+        if (!same) subject_ = ++subjectCount_;
+        face.subject = subject_;
+        subjectMisses_ = 0;
+        out.push_back(face);
+    } else if (subject_ && ++subjectMisses_ > policy_.subjectMemory) {
+        subject_ = 0;
+    }
+
+    // Lock onto the face the flow uses; a miss after a full scan starts the
+    // count again so an empty scene costs one full scan per fullFrameEvery frames.
+    if (!out.empty()) {
+        lockOnto(out.front().points);
+        misses_ = 0;
+        lastBox_ = out.front().box;
+        if (inference_.every > 1) {
+            predictor_.measure(out.front().points);
+            thumbnail(work_, lastFace_, trackScale_, thumb_);
+        }
+    } else {
+        haveLastFace_ = false;
+        misses_ = fullFrameSearch_ ? 0 : misses_ + 1;
+        predictor_.reset();
+    }
+}
+
+// Index into boxes (work_ coordinates) of the subject's face, or -1; same
+// tells whether it continues the current subject. While the subject is
+// remembered only its own box will do: anyone else waits until it is
+// forgotten, so a missed detection cannot hand the session over.
+int FaceTrackerAdapter::selectSubject(const std::vector<dlib::rectangle>& boxes, bool& same) const {
+    const float toFrame = 1.f / trackScale_;
+    const bool remembered = subject_ != 0 && subjectMisses_ <= policy_.subjectMemory;
+    int best = -1;
+    float bestOverlap = 0.f, bestInside = -1.f, bestArea = 0.f;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        const dlib::rectangle& b = boxes[i];
+        ofRectangle r(b.left() * toFrame, b.top() * toFrame, b.width() * toFrame, b.height() * toFrame);
+        if (remembered) {
+            float o = overlap(r, lastBox_);
+            if (o >= policy_.sameSubjectOverlap && o > bestOverlap) {
+                best = (int)i;
+                bestOverlap = o;
+            }
+            continue;
+        }
+        // The face most inside the oval, the nearer (larger) one on a tie.
+        float inside = insideShare(r, geometry_.oval);
+        if (inside > bestInside || (inside == bestInside && r.getArea() > bestArea)) {
+            best = (int)i;
+            bestInside = inside;
+            bestArea = r.getArea();
+        }
+    }
+    same = remembered;
+    return best;
+}
+
+void FaceTrackerAdapter::lockOnto(const LandmarkFrame& pts) {
+    glm::vec2 lo = pts[0], hi = pts[0];
+    for (const auto& p : pts) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    lastFace_ = ofRectangle(lo.x, lo.y, hi.x - lo.x, hi.y - lo.y);
+    haveLastFace_ = true;
+}
+
+// Small grayscale copy of box (frame coordinates) in img, which is the frame
+// scaled by scale; used to notice when the face changes between measurements.
+void FaceTrackerAdapter::thumbnail(const cv::Mat& img, const ofRectangle& box, float scale, cv::Mat& out) const {
+    const int kSide = 24;
+    cv::Rect r = cv::Rect(std::lround(box.x * scale), std::lround(box.y * scale),
+                          std::lround(box.width * scale), std::lround(box.height * scale)) &
+                 cv::Rect(0, 0, img.cols, img.rows);
+    if (r.area() <= 0) {
+        out = cv::Mat();
+        return;
+    }
+    cv::resize(img(r), out, cv::Size(kSide, kSide), 0, 0, cv::INTER_AREA);
+}
+
+bool FaceTrackerAdapter::canPredict(ofPixels& frame) {
+    if (inference_.every <= 1 || !predictor_.ready()) return false;
+    if (predictor_.framesSinceMeasure() + 1 >= inference_.every) return false;
+    if (predictor_.normalizedSpeed() > inference_.maxSpeed) return false;
+    if (thumb_.empty()) return false;
+
+    // Only the face box is converted, at the size the thumbnail was taken.
+    cv::Mat src = ofxCv::toCv(frame);
+    thumbnail(src, lastFace_, 1.f, thumbNow_);
+    if (thumbNow_.empty()) return false;
+    if (thumbNow_.channels() > 1) {
+        cv::cvtColor(thumbNow_, thumbGray_, thumbNow_.channels() == 4 ? cv::COLOR_RGBA2GRAY : cv::COLOR_RGB2GRAY);
+    } else {
+        thumbGray_ = thumbNow_;
+    }
+    double change = cv::norm(thumbGray_, thumb_, cv::NORM_L1) / double(thumb_.total());
+    return change <= inference_.maxImageChange;
+}
+
+bool FaceTrackerAdapter::hasFace() const {
+    return !faces_.empty();
+}
+
+bool FaceTrackerAdapter::getDerolled(DerolledData& out) const {
+    PROFILE_SCOPE(prof::DEROLL);
+    if (faces_.empty()) {
+        out = DerolledData{};
+        return false;
+    }
+    bool ok = deroll(faces_.front().points, geometry_.oval, out);
+    out.predicted = faces_.front().predicted;
+    return ok;
+}
+
+bool FaceTrackerAdapter::deroll(const LandmarkFrame& pts, const guide::Oval& oval, DerolledData& out) {
+    kernels::DerollResult r;
+    kernels::deroll(pts, oval, out.points, r);
+
+    const float cs = std::cos(-r.roll), sn = std::sin(-r.roll);
+    auto rotate = [&](const glm::vec2& p) {
+        glm::vec2 t = p - r.center;
+        return glm::vec2(cs * t.x - sn * t.y, sn * t.x + cs * t.y) + r.center;
+    };
+    out.leftEyeC    = rotate(r.leftEyeC);
+    out.rightEyeC   = rotate(r.rightEyeC);
+    out.faceCenter  = r.center;
+    out.iod         = math2d::interOcular(out.leftEyeC, out.rightEyeC);
+    out.insideGuide = r.inside >= (int)(guide::kInsideFraction * LM_NUM_POINTS);
     out.valid = true;
+    out.predicted = false;
     return true;
 }
+
+void FaceTrackerAdapter::drawFaces(const std::vector<TrackedFace>& faces) {
+    ofPushStyle();
+    ofNoFill();
+    for (const auto& f : faces) {
+        ofSetColor(255, 255, 255, 120);
+        ofDrawRectangle(f.box);
+
+        ofSetColor(255);
+        auto feature = [&](int a, int b, bool closed) {
+            ofPolyline line;
+            for (int i = a; i <= b; ++i) line.addVertex(f.points[i].x, f.points[i].y);
+            if (closed) line.close();
+            line.draw();
+        };
+        feature(LM_JAW_START,         LM_JAW_END,         false);
+        feature(LM_LEFT_BROW_START,   LM_LEFT_BROW_END,   false);
+        feature(LM_RIGHT_BROW_START,  LM_RIGHT_BROW_END,  false);
+        feature(LM_NOSE_BRIDGE_START, LM_NOSE_BRIDGE_END, false);
+        feature(LM_NOSE_BASE_START,   LM_NOSE_BASE_END,   false);
+        feature(LM_LEFT_EYE_START,    LM_LEFT_EYE_END,    true);
+        feature(LM_RIGHT_EYE_START,   LM_RIGHT_EYE_END,   true);
+        feature(LM_OUTER_MOUTH_START, LM_OUTER_MOUTH_END, true);
+        feature(LM_INNER_MOUTH_START, LM_INNER_MOUTH_END, true);
+    }
+    ofPopStyle();
+}
@@ -1,28 +1,179 @@
 #pragma once
 #include "ofMain.h"
-#include "ofxFaceTracker2.h"
+#include "ofxCv.h"
+#include <memory>
 #include <vector>
-#include "Landmarks68.h"
+#include "FaceDetector.h"
+#include "FrameGate.h"
+#include "LandmarkFrame.h"
+#include "LandmarkModel.h"
+#include "LandmarkPredictor.h"
 #include "Math2D.h"
+#include "Metrics.h"
 #include "GuideOval.h"
 
 struct DerolledData {
-    std::vector<glm::vec2> points;
+    LandmarkFrame points;
     glm::vec2 leftEyeC{0,0};
     glm::vec2 rightEyeC{0,0};
     glm::vec2 faceCenter{0,0};
     float iod = 1.f;
     bool  insideGuide = false;
     bool  valid = false;
+    bool  predicted = false; // points extrapolated, the landmark model was skipped
 };
 
+struct TrackedFace {
+    ofRectangle box;               // detector box, image coordinates
+    LandmarkFrame points; // image coordinates
+    bool predicted = false;
+    uint64_t subject = 0;          // see FaceTrackerAdapter::subject()
+};
+
+// Detection and landmarking run synchronously in update(); callers that must
+// not block (the live app) drive it from their own thread, see TrackingPipeline.
 class FaceTrackerAdapter {
 public:
+    // Where the face detector looks. Only a face inside the guide oval
+    // matters, so by default it searches a padded crop around the oval, or
+    // around the previous frame's landmarks once a face is locked, and scans
+    // the whole frame once every fullFrameEvery consecutive misses.
+    //
+    // Of the faces found, only the subject is landmarked: the box that
+    // continues the current subject's (IoU of at least sameSubjectOverlap).
+    // Other faces are passed over until the subject has gone unseen for
+    // subjectMemory measured frames; then the one most inside the guide
+    // oval becomes a new subject. People passing behind the patient cost a
+    // detection box each, no more.
+    struct DetectionPolicy {
+        bool  useRoi = true;
+        float ovalPadding = 0.25f;  // crop grows by this fraction of the oval's box per side
+        float facePadding = 0.30f;  // same, around the last landmark box
+        int   fullFrameEvery = 8;   // misses before one full-frame scan
+        float sameSubjectOverlap = 0.3f;
+        int   subjectMemory = 15;   // measured frames without a face before the subject is forgotten
+    };
+
+    // How often the landmark model runs. With every > 1 frames in between are
+    // predicted from the last measurements, unless the face moves faster
+    // than maxSpeed (IODs per frame) or the image inside its box changes by
+    // more than maxImageChange (mean absolute gray level), in which case the
+    // frame is measured anyway.
+    struct InferencePolicy {
+        int   every = 1;
+        float maxSpeed = 0.02f;
+        float maxImageChange = 6.f;
+    };
+
+    struct DetectionStats {
+        uint64_t searches = 0;
+        uint64_t fullFrameSearches = 0;
+        double   seconds = 0.0; // wall time spent in the detector, conversions included
+    };
+
+    // Uses the process-wide instance of the model (LandmarkModel::shared).
     void setup(const std::string& modelPath);
-    void update(ofVideoGrabber& grabber);
+    // Uses an already loaded model, shared read-only with other trackers.
+    void setup(std::shared_ptr<const LandmarkModel> model);
+    void update(ofPixels& frame);
+    // Forgets the locked face and the miss count, e.g. between clips.
+    void reset();
     bool hasFace() const;
+    // Identity of the face in faces(): the same number for as long as the
+    // same person is followed, a new one for each new subject, 0 for none.
+    uint64_t subject() const { return faces_.empty() ? 0 : faces_.front().subject; }
     bool getDerolled(DerolledData& out) const;
-    ofxFaceTracker2& tracker() { return tracker_; }
+    // Roll-normalizes one face's landmarks about the eye midpoint and tests
+    // them against the guide oval of the frame they came from.
+    static bool deroll(const LandmarkFrame& pts, const guide::Oval& oval, DerolledData& out);
+    // The subject's face, or none.
+    const std::vector<TrackedFace>& faces() const { return faces_; }
+    // Draws boxes and feature outlines in image coordinates.
+    static void drawFaces(const std::vector<TrackedFace>& faces);
+
+    // Replaces the detector; setup() installs HOG when none was given.
+    void setDetector(std::unique_ptr<FaceDetector> d) { detector_ = std::move(d); }
+    const FaceDetector* detector() const { return detector_.get(); }
+    // Face detection runs on a grayscale copy downscaled so the full frame
+    // would be at most this many pixels; crops use the same scale.
+    void setDetectorImageSize(int numPixels) { detectorPixels_ = numPixels; }
+    // Detection and landmarking both run on a copy scaled by this factor
+    // (0 < s <= 1); points and boxes are still reported in frame coordinates.
+    void setTrackingScale(float s) { trackScale_ = ofClamp(s, 0.1f, 1.f); }
+    float trackingScale() const { return trackScale_; }
+    // Geometry of the last frame passed to update().
+    const guide::GuideGeometry& geometry() const { return geometry_; }
+    void setDetectionPolicy(const DetectionPolicy& p) { policy_ = p; }
+    const DetectionPolicy& detectionPolicy() const { return policy_; }
+    const DetectionStats&  detectionStats() const  { return stats_; }
+    void setInferencePolicy(const InferencePolicy& p) { inference_ = p; }
+    const InferencePolicy& inferencePolicy() const { return inference_; }
+    uint64_t predictedFrames() const { return predictedFrames_; }
+    // Frames the gate rejects are neither detected nor landmarked; the locked
+    // face and the predictor are kept for the next usable frame.
+    void setFrameGate(const FrameGate::Settings& s) { gate_.setup(s); }
+    const FrameGate& frameGate() const { return gate_; }
+    // False when the last frame passed to update() was rejected by the gate:
+    // faces() then still holds the last measured face, so overlays and
+    // recordings do not flicker.
+    bool measured() const { return measured_; }
+
+    // Per-frame figures for monitoring, under the given labels.
+    struct Metrics {
+        Metrics(metrics::Registry& r, const metrics::Labels& labels);
+        metrics::Histogram* seconds;    // update() wall time
+        metrics::Counter*   frames;
+        metrics::Counter*   faceFrames; // measured frames with a face, predicted ones included
+        metrics::Counter*   predicted;
+        metrics::Counter*   facesLost;  // a face on one measured frame, none on the next
+        metrics::Counter*   searches;
+        metrics::Counter*   subjects;   // new subjects taken on
+        metrics::Counter*   gated[FrameGate::BLURRY + 1] = {}; // by verdict; PASS unused
+        bool hadFace = false;
+        uint64_t lastSubject = 0;
+    };
+    // Reports every update() to r from now on; nullptr stops reporting.
+    void setMetrics(metrics::Registry* r, const metrics::Labels& labels = {});
+
 private:
-    ofxFaceTracker2 tracker_;
+    void detect(ofPixels& frame, std::vector<dlib::rectangle>& boxes);
+    cv::Rect searchRegion() const;
+    int selectSubject(const std::vector<dlib::rectangle>& boxes, bool& same) const;
+    bool canPredict(ofPixels& frame);
+    void thumbnail(const cv::Mat& img, const ofRectangle& box, float scale, cv::Mat& out) const;
+    void lockOnto(const LandmarkFrame& pts);
+    void track(ofPixels& frame, std::vector<TrackedFace>& out);
+
+    std::shared_ptr<const LandmarkModel> model_;
+    std::unique_ptr<FaceDetector> detector_;
+    int     detectorPixels_ = 640 * 480;
+    float   trackScale_ = 1.f;
+    guide::GuideGeometry geometry_;
+    cv::Mat gray_, work_, small_;
+    std::vector<cv::Rect>        found_;  // detector output, small_ coordinates
+    std::vector<dlib::rectangle> boxes_;  // work_ coordinates
+    std::vector<TrackedFace> faces_;
+    uint64_t frameCount_ = 0;
+
+    DetectionPolicy policy_;
+    DetectionStats  stats_;
+    ofRectangle lastFace_;          // landmark bounding box of the locked face, frame coordinates
+    bool        haveLastFace_ = false;
+    bool        fullFrameSearch_ = false;
+    int         misses_ = 0;
+
+    uint64_t    subject_ = 0;       // 0: none
+    uint64_t    subjectCount_ = 0;
+    int         subjectMisses_ = 0;
+
+    InferencePolicy   inference_;
+    LandmarkPredictor predictor_;
+    cv::Mat     thumb_, thumbNow_, thumbGray_; // face box at the last measurement, and now
+    ofRectangle lastBox_;           // the face's detector box, frame coordinates
+    uint64_t    predictedFrames_ = 0;
+
+    FrameGate   gate_;
+    bool        measured_ = true;
+
+    std::unique_ptr<Metrics> metrics_;
 };
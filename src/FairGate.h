@@ -0,0 +1,45 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Lets at most `slots` threads through at a time, strictly in the order they
+// arrived. A thread that leaves and comes straight back queues behind every
+// thread already waiting, so stations sharing the gate take turns and a
+// station whose frames are expensive cannot lock the others out.
+class FairGate {
+public:
+    explicit FairGate(int slots = 1) : slots_(slots < 1 ? 1 : slots) {}
+
+    void enter() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const uint64_t ticket = next_++;
+        cv_.wait(lock, [&] { return ticket < left_ + slots_; });
+    }
+    void leave() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            left_++;
+        }
+        cv_.notify_all();
+    }
+
+    int slots() const { return (int)slots_; }
+
+    class Scope {
+    public:
+        explicit Scope(FairGate* gate) : gate_(gate) { if (gate_) gate_->enter(); }
+        ~Scope() { if (gate_) gate_->leave(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        FairGate* gate_;
+    };
+
+private:
+    std::mutex              mutex_;
+    std::condition_variable cv_;
+    const uint64_t          slots_;
+    uint64_t                next_ = 0; // tickets handed out
+    uint64_t                left_ = 0; // tickets that have left
+};
@@ -0,0 +1,43 @@
+#include "FlowInputs.h"
+#include "Landmarks68.h"
+
+SmileFlow::Inputs makeFlowInputs(const FaceTrackerAdapter& tracker, DerolledData& der, float dt) {
+    bool haveDer = tracker.getDerolled(der);
+    return makeFlowInputs(tracker.hasFace(), haveDer, der, dt, tracker.measured());
+}
+
+SmileFlow::Inputs makeFlowInputs(bool hasFace, bool haveDer, const DerolledData& der, float dt,
+                                 bool measured) {
+    SmileFlow::Inputs in;
+    in.measured       = measured;
+    in.hasFace        = hasFace;
+    in.insideGuide    = haveDer ? der.insideGuide : false;
+    in.dt             = dt;
+    in.iod            = haveDer ? der.iod : 1.f;
+    in.faceCenter     = haveDer ? der.faceCenter : glm::vec2(0,0);
+    in.derolled       = haveDer ? &der.points : nullptr;
+    if (haveDer) {
+        in.haveMouth  = true;
+        in.mouthLeft  = der.points[LM_LEFT_MOUTH_CORNER];
+        in.mouthRight = der.points[LM_RIGHT_MOUTH_CORNER];
+    }
+    return in;
+}
+
+SmileFlow::Inputs makeFlowInputs(const LandmarkRecord& r, float dt) {
+    const bool haveDer = (r.flags & LandmarkRecord::DEROLLED) != 0;
+    SmileFlow::Inputs in;
+    in.measured       = (r.flags & LandmarkRecord::UNMEASURED) == 0;
+    in.hasFace        = (r.flags & LandmarkRecord::HAS_FACE) != 0;
+    in.insideGuide    = haveDer && (r.flags & LandmarkRecord::INSIDE_GUIDE);
+    in.dt             = dt;
+    in.iod            = haveDer ? r.iod : 1.f;
+    in.faceCenter     = haveDer ? r.faceCenter : glm::vec2(0,0);
+    in.derolled       = haveDer ? &r.derolled : nullptr;
+    if (haveDer) {
+        in.haveMouth  = true;
+        in.mouthLeft  = r.derolled[LM_LEFT_MOUTH_CORNER];
+        in.mouthRight = r.derolled[LM_RIGHT_MOUTH_CORNER];
+    }
+    return in;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "FaceTrackerAdapter.h"
+#include "LandmarkRecording.h"
+#include "SmileFlow.h"
+
+// The flow's dt, from the frames' own timestamps (seconds, any origin):
+// the time since the previous frame, 0 for the first. Whatever stamps the
+// frames, a camera thread or a scripted clock, drives the flow.
+class FrameInterval {
+public:
+    float next(double time) {
+        float dt = last_ < 0.0 ? 0.f : (float)std::max(0.0, time - last_);
+        last_ = time;
+        return dt;
+    }
+    void reset() { last_ = -1.0; }
+private:
+    double last_ = -1.0;
+};
+
+// Tells when the tracker's subject changes in the middle of a screening,
+// i.e. someone else's landmarks would go on to finish it.
+class SubjectWatch {
+public:
+    bool changed(uint64_t subject, SmileFlow::Stage stage) {
+        if (subject == 0) return false;
+        const bool screening = stage == SmileFlow::STAGE_HOLD_STILL || stage == SmileFlow::STAGE_PROMPT_SMILE;
+        const bool changed = screening && last_ != 0 && subject != last_;
+        last_ = subject;
+        return changed;
+    }
+    void reset() { last_ = 0; }
+private:
+    uint64_t last_ = 0;
+};
+
+// Assembles one frame's SmileFlow inputs from the tracker's latest result.
+// The inputs borrow der's points, so der must outlive the SmileFlow::update call.
+SmileFlow::Inputs makeFlowInputs(const FaceTrackerAdapter& tracker, DerolledData& der, float dt);
+// Same, from an already derolled face (replay, synthetic streams).
+SmileFlow::Inputs makeFlowInputs(bool hasFace, bool haveDer, const DerolledData& der, float dt,
+                                 bool measured = true);
+// Same, from a recorded frame; the inputs borrow the record's points.
+SmileFlow::Inputs makeFlowInputs(const LandmarkRecord& r, float dt);
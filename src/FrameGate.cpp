@@ -0,0 +1,57 @@
+#include "FrameGate.h"
+
+const char* FrameGate::verdictName(Verdict v) {
+    switch (v) {
+        case PASS:   return "pass";
+        case DARK:   return "dark";
+        case BRIGHT: return "bright";
+        case BLURRY: return "blurry";
+        default:     return "unknown";
+    }
+}
+
+bool FrameGate::admit(const cv::Mat& frame, const ofRectangle& region) {
+    stats_.frames++;
+    last_ = check(frame, region);
+    switch (last_) {
+        case PASS:
+            stats_.passed++;
+            consecutive_ = 0;
+            return true;
+        case DARK:   stats_.dark++;   break;
+        case BRIGHT: stats_.bright++; break;
+        case BLURRY: stats_.blurry++; break;
+    }
+    if (++consecutive_ > settings_.maxConsecutive) {
+        consecutive_ = 0;
+        stats_.forced++;
+        return true;
+    }
+    return false;
+}
+
+FrameGate::Verdict FrameGate::check(const cv::Mat& frame, const ofRectangle& region) {
+    cv::Rect r = cv::Rect(std::lround(region.x), std::lround(region.y),
+                          std::lround(region.width), std::lround(region.height)) &
+                 cv::Rect(0, 0, frame.cols, frame.rows);
+    if (r.area() <= 0) return PASS; // nothing to judge by
+
+    // Sampling to a fixed size keeps the thresholds independent of the
+    // camera resolution; only the patch is converted.
+    float s = std::min(1.f, float(settings_.sampleSide) / std::max(r.width, r.height));
+    if (s < 1.f) cv::resize(frame(r), sample_, cv::Size(), s, s, cv::INTER_AREA);
+    else         sample_ = frame(r);
+    if (sample_.channels() == 1) gray_ = sample_;
+    else cv::cvtColor(sample_, gray_, sample_.channels() == 4 ? cv::COLOR_RGBA2GRAY : cv::COLOR_RGB2GRAY);
+
+    brightness_ = (float)cv::mean(gray_)[0];
+    cv::Laplacian(gray_, laplacian_, CV_16S);
+    cv::Scalar mean, stddev;
+    cv::meanStdDev(laplacian_, mean, stddev);
+    sharpness_ = float(stddev[0] * stddev[0]);
+
+    if (brightness_ < settings_.minBrightness) return DARK;
+    if (brightness_ > settings_.maxBrightness) return BRIGHT;
+    if (sharpness_ < settings_.minSharpness)   return BLURRY;
+    return PASS;
+}
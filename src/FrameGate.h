@@ -0,0 +1,55 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxCv.h"
+
+// Cheap check of whether a frame is worth tracking at all: the guide oval's
+// region is sampled down to a small grayscale patch and rejected when it is
+// too dark, blown out, or too blurred (or featureless) by the variance of its
+// Laplacian. A rejected frame is "no measurement": the tracker skips it and
+// SmileFlow keeps its state as it was.
+class FrameGate {
+public:
+    struct Settings {
+        bool  enabled = true;
+        float minBrightness = 35.f;  // mean gray level of the patch
+        float maxBrightness = 225.f;
+        float minSharpness = 15.f;   // variance of the Laplacian of the patch
+        int   sampleSide = 96;       // longest side of the patch, pixels
+        // Past this many rejections in a row the next frame is tracked
+        // anyway, so a face that left the oval is still noticed.
+        int   maxConsecutive = 15;
+    };
+
+    enum Verdict { PASS = 0, DARK, BRIGHT, BLURRY };
+    static const char* verdictName(Verdict v);
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t passed = 0;
+        uint64_t dark = 0, bright = 0, blurry = 0;
+        uint64_t forced = 0; // rejected but tracked anyway, see maxConsecutive
+        uint64_t rejected() const { return dark + bright + blurry; }
+    };
+
+    void setup(const Settings& s) { settings_ = s; reset(); }
+    const Settings& settings() const { return settings_; }
+    void reset() { consecutive_ = 0; }
+
+    // frame is RGB(A) or gray; region in frame coordinates. True when the
+    // frame should be tracked.
+    bool admit(const cv::Mat& frame, const ofRectangle& region);
+    Verdict check(const cv::Mat& frame, const ofRectangle& region);
+
+    Verdict lastVerdict() const    { return last_; }
+    float   lastBrightness() const { return brightness_; }
+    float   lastSharpness() const  { return sharpness_; }
+    const Stats& stats() const     { return stats_; }
+
+private:
+    Settings settings_;
+    Stats    stats_;
+    Verdict  last_ = PASS;
+    float    brightness_ = 0.f, sharpness_ = 0.f;
+    int      consecutive_ = 0;
+    cv::Mat  sample_, gray_, laplacian_;
+};
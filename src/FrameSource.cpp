@@ -0,0 +1,109 @@
+#include "FrameSource.h"
+
+namespace {
+const std::vector<std::string> kVideoExts = { "mp4", "mov", "avi", "mkv", "m4v" };
+const std::vector<std::string> kImageExts = { "png", "jpg", "jpeg", "bmp", "tif", "tiff" };
+
+bool hasExt(const std::string& path, const std::vector<std::string>& exts) {
+    std::string ext = ofToLower(ofFilePath::getFileExt(path));
+    return std::find(exts.begin(), exts.end(), ext) != exts.end();
+}
+} // namespace
+
+bool VideoFileSource::open(const std::string& path) {
+    path_ = path;
+    index_ = 0;
+    if (!cap_.open(ofToDataPath(path, true))) return false;
+    double fps = cap_.get(cv::CAP_PROP_FPS);
+    fps_ = fps > 0 ? fps : 30.0;
+    return true;
+}
+
+bool VideoFileSource::next(Frame& out) {
+    if (!cap_.isOpened() || !cap_.read(bgr_) || bgr_.empty()) return false;
+    if (out.pixels.getWidth()  != (size_t)bgr_.cols ||
+        out.pixels.getHeight() != (size_t)bgr_.rows ||
+        out.pixels.getNumChannels() != 3) {
+        out.pixels.allocate(bgr_.cols, bgr_.rows, OF_PIXELS_RGB);
+    }
+    cv::Mat rgb = ofxCv::toCv(out.pixels);
+    cv::cvtColor(bgr_, rgb, cv::COLOR_BGR2RGB);
+
+    // POS_MSEC is the presentation time of the frame just decoded; some
+    // containers report 0 throughout, so fall back to the nominal rate.
+    double ms = cap_.get(cv::CAP_PROP_POS_MSEC);
+    out.timestamp = (ms > 0 || index_ == 0) ? ms / 1000.0 : index_ / fps_;
+    out.index = index_++;
+    return true;
+}
+
+bool ImageSequenceSource::open(const std::string& dir, double fps) {
+    path_ = dir;
+    fps_ = fps > 0 ? fps : 30.0;
+    index_ = 0;
+    files_.clear();
+    ofDirectory d(dir);
+    for (const auto& ext : kImageExts) d.allowExt(ext);
+    d.listDir();
+    d.sort();
+    for (size_t i = 0; i < d.size(); ++i) files_.push_back(d.getPath(i));
+    return !files_.empty();
+}
+
+bool ImageSequenceSource::next(Frame& out) {
+    while (index_ < files_.size()) {
+        size_t i = index_++;
+        if (!ofLoadImage(out.pixels, files_[i])) {
+            ofLogWarning("ImageSequenceSource") << "skipping unreadable " << files_[i];
+            continue;
+        }
+        if (out.pixels.getNumChannels() != 3) out.pixels.setImageType(OF_IMAGE_COLOR);
+        out.timestamp = i / fps_;
+        out.index = i;
+        return true;
+    }
+    return false;
+}
+
+namespace frames {
+bool isVideoFile(const std::string& path) {
+    return hasExt(path, kVideoExts);
+}
+
+bool isImageSequence(const std::string& dir) {
+    ofDirectory d(dir);
+    if (!d.isDirectory()) return false;
+    for (const auto& ext : kImageExts) d.allowExt(ext);
+    return d.listDir() > 0;
+}
+
+std::unique_ptr<FrameSource> open(const std::string& path, double sequenceFps) {
+    if (isImageSequence(path)) {
+        auto src = std::make_unique<ImageSequenceSource>();
+        if (src->open(path, sequenceFps)) return src;
+    } else if (isVideoFile(path)) {
+        auto src = std::make_unique<VideoFileSource>();
+        if (src->open(path)) return src;
+    }
+    ofLogError("frames") << "cannot open " << path;
+    return nullptr;
+}
+
+std::vector<std::string> collectClips(const std::vector<std::string>& paths) {
+    std::vector<std::string> clips;
+    for (const auto& p : paths) {
+        ofDirectory d(p);
+        if (!d.isDirectory() || isImageSequence(p)) {
+            clips.push_back(p);
+            continue;
+        }
+        d.listDir();
+        d.sort();
+        for (size_t i = 0; i < d.size(); ++i) {
+            std::string child = d.getPath(i);
+            if (isVideoFile(child) || isImageSequence(child)) clips.push_back(child);
+        }
+    }
+    return clips;
+}
+} // namespace frames
@@ -0,0 +1,54 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxCv.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Frame {
+    ofPixels pixels;        // RGB
+    double   timestamp = 0; // seconds, taken from the media (not the wall clock)
+    size_t   index = 0;
+};
+
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+    virtual bool next(Frame& out) = 0;
+    virtual const std::string& name() const = 0;
+};
+
+// Decodes a video file with OpenCV; needs no window or GL context.
+class VideoFileSource : public FrameSource {
+public:
+    bool open(const std::string& path);
+    bool next(Frame& out) override;
+    const std::string& name() const override { return path_; }
+private:
+    std::string      path_;
+    cv::VideoCapture cap_;
+    cv::Mat          bgr_;
+    double           fps_ = 30.0;
+    size_t           index_ = 0;
+};
+
+// A directory of still images, read in name order at a fixed frame rate.
+class ImageSequenceSource : public FrameSource {
+public:
+    bool open(const std::string& dir, double fps = 30.0);
+    bool next(Frame& out) override;
+    const std::string& name() const override { return path_; }
+private:
+    std::string              path_;
+    std::vector<std::string> files_;
+    double                   fps_ = 30.0;
+    size_t                   index_ = 0;
+};
+
+namespace frames {
+bool isVideoFile(const std::string& path);
+bool isImageSequence(const std::string& dir);
+std::unique_ptr<FrameSource> open(const std::string& path, double sequenceFps = 30.0);
+// Expands directories into the clips they contain (video files or image-sequence folders).
+std::vector<std::string> collectClips(const std::vector<std::string>& paths);
+} // namespace frames
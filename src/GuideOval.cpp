@@ -1,18 +1,25 @@
 #include "GuideOval.h"
+#include "DerollKernels.h"
 
 namespace guide {
-bool mostlyInsideGuide(const std::vector<glm::vec2>& pts, float fractionNeeded) {
-    if (pts.empty()) return false;
-    float ovalCenterX = 1280.0f * 0.5f;
-    float ovalCenterY = 720.0f * 0.60f;
-    float ovalA = 1280.0f * 0.13f;
-    float ovalB = 720.0f * 0.28f;
-    int insideCount = 0;
-    for (const auto& p : pts) {
-        float nx = (p.x - ovalCenterX) / ovalA;
-        float ny = (p.y - ovalCenterY) / ovalB;
-        if (nx*nx + ny*ny <= 1.f) insideCount++;
-    }
-    return insideCount >= (int)(fractionNeeded * pts.size());
+GuideGeometry geometryFor(int frameWidth, int frameHeight) {
+    // Both semi-axes follow the frame height, so the oval keeps the shape it
+    // has at 1280x720 (a = 0.13 * 1280) on 4:3 frames as well.
+    const float h = (float)frameHeight;
+    GuideGeometry g;
+    g.frameWidth  = frameWidth;
+    g.frameHeight = frameHeight;
+    g.oval.center = glm::vec2(frameWidth * 0.5f, h * 0.60f);
+    g.oval.a = h * (0.13f * kReferenceWidth / kReferenceHeight);
+    g.oval.b = h * 0.28f;
+    return g;
+}
+
+int countInside(const LandmarkFrame& pts, const Oval& oval) {
+    return kernels::countInside(pts, oval);
+}
+
+bool mostlyInsideGuide(const LandmarkFrame& pts, const Oval& oval, float fractionNeeded) {
+    return countInside(pts, oval) >= (int)(fractionNeeded * pts.size());
 }
 } // namespace guide
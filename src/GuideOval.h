@@ -1,7 +1,29 @@
 #pragma once
 #include "ofMain.h"
-#include <vector>
+#include "LandmarkFrame.h"
 
 namespace guide {
-bool mostlyInsideGuide(const std::vector<glm::vec2>& pts, float fractionNeeded = 0.92f);
+// The frame size the guide proportions were designed at.
+constexpr int kReferenceWidth  = 1280;
+constexpr int kReferenceHeight = 720;
+// Share of landmarks that must be inside the oval to count as aligned.
+constexpr float kInsideFraction = 0.92f;
+
+struct Oval {
+    glm::vec2 center{0,0};
+    float a = 1.f; // semi-axes
+    float b = 1.f;
+};
+
+// Guide oval for one camera frame size, in that frame's pixel coordinates.
+// Tracking and rendering both derive it from the actual frame size.
+struct GuideGeometry {
+    int  frameWidth  = kReferenceWidth;
+    int  frameHeight = kReferenceHeight;
+    Oval oval;
+};
+GuideGeometry geometryFor(int frameWidth, int frameHeight);
+
+int  countInside(const LandmarkFrame& pts, const Oval& oval);
+bool mostlyInsideGuide(const LandmarkFrame& pts, const Oval& oval, float fractionNeeded = kInsideFraction);
 } // namespace guide
@@ -0,0 +1,494 @@
+#include "IngestService.h"
+#include "FairGate.h"
+#include "FlowInputs.h"
+#include "FrameSource.h"
+#include "LandmarkModel.h"
+#include "SharedFrameRing.h"
+#include "SmileFlow.h"
+#include "Stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace ingest {
+namespace {
+
+// How long an idle session waits for a frame or a command.
+const int kIdleMillis = 1;
+// How long either side waits for the other's first line.
+const int kHelloMillis = 5000;
+// How often the accept loop looks for a stop request.
+const int kAcceptMillis = 200;
+
+std::atomic<bool> stopRequested{false};
+void onSignal(int) { stopRequested = true; }
+
+// Line-at-a-time reads from a socket.
+class LineReader {
+public:
+    explicit LineReader(int fd) : fd_(fd) {}
+    // The next complete line, waiting at most timeoutMs for more data.
+    // False on timeout or once the peer has closed, which eof() tells apart.
+    bool next(std::string& line, int timeoutMs);
+    bool eof() const { return eof_; }
+private:
+    int         fd_;
+    std::string buf_;
+    bool        eof_ = false;
+};
+
+bool LineReader::next(std::string& line, int timeoutMs) {
+    while (true) {
+        size_t nl = buf_.find('\n');
+        if (nl != std::string::npos) {
+            line.assign(buf_, 0, nl);
+            buf_.erase(0, nl + 1);
+            return true;
+        }
+        if (eof_) return false;
+        pollfd p{ fd_, POLLIN, 0 };
+        if (poll(&p, 1, timeoutMs) <= 0) return false;
+        char chunk[1024];
+        ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            eof_ = true;
+            return false;
+        }
+        buf_.append(chunk, (size_t)n);
+        timeoutMs = 0;
+    }
+}
+
+bool sendAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, 0);
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+bool sendLine(int fd, const std::string& line) {
+    return sendAll(fd, line.data(), line.size()) && sendAll(fd, "\n", 1);
+}
+
+sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+// One client connection: its ring, tracker and flow, on a thread of its own.
+class Session {
+public:
+    Session(int fd, int id, const Settings& s, std::shared_ptr<const LandmarkModel> model, FairGate* gate);
+    ~Session();
+    bool done() const { return done_; }
+    // Wakes the session thread; the destructor then joins it.
+    void stop();
+
+private:
+    void run();
+    bool hello(LineReader& in);
+    void command(const std::string& line);
+    bool track(int slot);
+
+    int                fd_;
+    int                id_;
+    FairGate*          gate_;
+    SharedFrameRing    ring_;
+    ofPixelFormat      format_ = OF_PIXELS_RGB;
+    ofPixels           pixels_; // wraps the slot being tracked, never owns it
+    FaceTrackerAdapter tracker_;
+    DerolledData       der_;
+    SmileFlow          flow_;
+    SubjectWatch       subjects_;
+    int64_t            lastCaptureNs_ = -1;
+    uint64_t           frames_ = 0;
+    double             trackSeconds_ = 0.0;
+    std::atomic<bool>  done_{false};
+    std::mutex         fdMutex_;        // run() closing fd_ against stop() shutting it down
+    bool               closed_ = false; // fd_ closed; the number may already be someone else's
+    std::thread        thread_;
+};
+
+Session::Session(int fd, int id, const Settings& s, std::shared_ptr<const LandmarkModel> model, FairGate* gate)
+    : fd_(fd), id_(id), gate_(gate) {
+    if (auto d = detectors::make(s.detector)) tracker_.setDetector(std::move(d));
+    tracker_.setTrackingScale(s.trackingScale);
+    tracker_.setInferencePolicy(s.inference);
+    tracker_.setFrameGate(s.gate);
+    tracker_.setup(model);
+    if (s.metrics.enabled()) {
+        tracker_.setMetrics(&metrics::Registry::global(), { { "station", "ingest" } });
+        flow_.setMetrics(&metrics::Registry::global(), { { "station", "ingest" } });
+    }
+    thread_ = std::thread(&Session::run, this);
+}
+
+Session::~Session() {
+    if (thread_.joinable()) thread_.join();
+}
+
+void Session::stop() {
+    std::lock_guard<std::mutex> lock(fdMutex_);
+    if (!closed_) shutdown(fd_, SHUT_RDWR);
+}
+
+void Session::run() {
+    LineReader in(fd_);
+    if (hello(in)) {
+        uint64_t next = 0;
+        std::string line;
+        while (true) {
+            if (in.next(line, 0)) {
+                command(line);
+                continue;
+            }
+            if (in.eof()) break;
+            int slot = ring_.acquireNewest(next);
+            if (slot < 0) {
+                // Nothing new: wait on the socket instead of sleeping.
+                if (in.next(line, kIdleMillis)) command(line);
+                continue;
+            }
+            next = ring_.slot(slot).frame + 1;
+            if (!track(slot)) break;
+        }
+        const uint64_t published = ring_.header().published.load(std::memory_order_acquire);
+        ofLogNotice("ingest") << "session " << id_ << ": " << frames_ << " of " << published << " frames tracked, "
+                              << ofToString(1000.0 * trackSeconds_ / std::max<uint64_t>(1, frames_), 1)
+                              << " ms per frame";
+    }
+    ring_.close();
+    {
+        std::lock_guard<std::mutex> lock(fdMutex_);
+        ::close(fd_);
+        closed_ = true;
+    }
+    done_ = true;
+}
+
+bool Session::hello(LineReader& in) {
+    std::string line;
+    if (!in.next(line, kHelloMillis)) return false;
+    ofJson j = ofJson::parse(line, nullptr, false);
+    std::string name = j.is_object() ? j.value("shm", "") : "";
+    std::string error;
+    if (name.empty()) {
+        error = "the first line names no ring";
+    } else if (!ring_.open(name)) {
+        error = "cannot map " + name;
+    } else if (ring_.channels() != 3 && ring_.channels() != 4) {
+        // Gray frames would be tracked without a copy and outlive their slot.
+        error = "frames must be RGB or RGBA";
+        ring_.close();
+    }
+    if (!error.empty()) {
+        ofLogWarning("ingest") << "session " << id_ << ": " << error;
+        sendLine(fd_, ofJson{ { "error", error } }.dump());
+        return false;
+    }
+    format_ = ring_.channels() == 4 ? OF_PIXELS_RGBA : OF_PIXELS_RGB;
+    ofLogNotice("ingest") << "session " << id_ << ": " << name << ", " << ring_.width() << "x" << ring_.height();
+    return sendLine(fd_, ofJson{ { "ok", true }, { "width", ring_.width() }, { "height", ring_.height() } }.dump());
+}
+
+// As the live keys: start leaves the home screen, reset starts over.
+void Session::command(const std::string& line) {
+    ofJson j = ofJson::parse(line, nullptr, false);
+    std::string cmd = j.is_object() ? j.value("cmd", "") : "";
+    if (cmd == "start") {
+        if (flow_.stage() == SmileFlow::STAGE_HOME) flow_.reset();
+    } else if (cmd == "reset") {
+        flow_.reset();
+    } else {
+        ofLogWarning("ingest") << "session " << id_ << ": ignoring " << line;
+    }
+}
+
+bool Session::track(int slot) {
+    const uint64_t frame = ring_.slot(slot).frame;
+    const int64_t captureNs = ring_.slot(slot).captureNs;
+    // The tracker reads the shared pixels in place; the producer gets the
+    // slot back as soon as the update is done with it.
+    pixels_.setFromExternalPixels(ring_.pixels(slot), ring_.width(), ring_.height(), format_);
+    {
+        FairGate::Scope turn(gate_);
+        auto t0 = std::chrono::steady_clock::now();
+        tracker_.update(pixels_);
+        trackSeconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+    ring_.release(slot);
+    frames_++;
+
+    // A new person in the oval starts the screening over.
+    if (subjects_.changed(tracker_.subject(), flow_.stage())) flow_.reset();
+
+    // The flow advances by capture time, so skipped frames still count.
+    float dt = lastCaptureNs_ < 0 ? 0.f : float((captureNs - lastCaptureNs_) * 1e-9);
+    lastCaptureNs_ = captureNs;
+    SmileFlow::Inputs in = makeFlowInputs(tracker_, der_, dt);
+    SmileFlow::Stage before = flow_.stage();
+    flow_.update(in);
+
+    char line[320];
+    int n = std::snprintf(line, sizeof(line),
+                          "{\"frame\":%llu,\"capture_ns\":%lld,\"stage\":\"%s\",\"progress\":%.3f,"
+                          "\"intensity\":%.4f,\"asymmetry\":%.4f,\"face\":%s}\n",
+                          (unsigned long long)frame, (long long)captureNs, SmileFlow::stageName(flow_.stage()),
+                          flow_.stabilityProgress(), flow_.smileIntensity(), flow_.smileAsymmetry(),
+                          tracker_.hasFace() ? "true" : "false");
+    if (!sendAll(fd_, line, (size_t)n)) return false;
+    if (flow_.stage() == SmileFlow::STAGE_EVALUATE && before != SmileFlow::STAGE_EVALUATE) {
+        n = std::snprintf(line, sizeof(line),
+                          "{\"frame\":%llu,\"verdict\":\"%s\",\"intensity\":%.4f,\"asymmetry\":%.4f}\n",
+                          (unsigned long long)frame, flow_.abnormal() ? "abnormal" : "normal",
+                          flow_.smileIntensity(), flow_.smileAsymmetry());
+        if (!sendAll(fd_, line, (size_t)n)) return false;
+    }
+    return true;
+}
+
+// What one stand-in client saw.
+struct ClientReport {
+    std::string clip;
+    uint64_t sent = 0;
+    uint64_t replies = 0;
+    std::string verdict;          // empty if the screening did not finish
+    std::vector<double> latencyMs; // capture to reply, one per reply
+};
+
+struct ClientOptions {
+    std::string socketPath;
+    bool asFast = false;
+    bool full = false;
+};
+
+bool runClient(int index, const std::string& clip, const ClientOptions& o, ClientReport& report) {
+    report.clip = clip;
+    auto source = frames::open(clip);
+    Frame f;
+    if (!source || !source->next(f)) {
+        ofLogError("ingest") << "cannot read " << clip;
+        return false;
+    }
+    SharedFrameRing ring;
+    const std::string name = "/smileflow-" + ofToString(getpid()) + "-" + ofToString(index);
+    if (!ring.create(name, f.pixels.getWidth(), f.pixels.getHeight(), f.pixels.getNumChannels())) return false;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = socketAddress(o.socketPath);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        ofLogError("ingest") << "cannot connect to " << o.socketPath << ": " << std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    LineReader in(fd);
+    std::string line;
+    sendLine(fd, "{\"shm\":\"" + name + "\"}");
+    if (!in.next(line, kHelloMillis) || line.find("\"ok\"") == std::string::npos) {
+        ofLogError("ingest") << clip << ": service refused the session: " << line;
+        ::close(fd);
+        return false;
+    }
+    sendLine(fd, "{\"cmd\":\"start\"}");
+
+    std::atomic<int64_t> lastReplied{-1};
+    std::atomic<bool> finished{false};
+    std::atomic<bool> hungUp{false};
+    std::thread reader([&]() {
+        std::string reply;
+        while (in.next(reply, -1)) {
+            const int64_t now = SharedFrameRing::nowNs();
+            ofJson j = ofJson::parse(reply, nullptr, false);
+            if (!j.is_object()) continue;
+            if (j.contains("verdict")) {
+                report.verdict = j.value("verdict", "");
+                finished = true;
+            } else if (j.contains("capture_ns")) {
+                report.latencyMs.push_back((now - j.value("capture_ns", int64_t(0))) * 1e-6);
+                report.replies++;
+                lastReplied = j.value("frame", int64_t(0));
+            }
+        }
+        hungUp = true;
+    });
+
+    const size_t bytes = f.pixels.getTotalBytes();
+    const auto start = std::chrono::steady_clock::now();
+    const double firstTimestamp = f.timestamp;
+    uint64_t frame = 0;
+    do {
+        if (o.asFast) {
+            // One frame in flight: as fast as the service answers, none skipped.
+            auto giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while (lastReplied + 1 < (int64_t)frame && !hungUp && std::chrono::steady_clock::now() < giveUp) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        } else {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>(f.timestamp - firstTimestamp)));
+        }
+        int slot = ring.beginWrite();
+        if (slot < 0) continue;
+        std::memcpy(ring.pixels(slot), f.pixels.getData(), std::min<size_t>(bytes, ring.header().slotBytes));
+        ring.endWrite(slot, frame++, SharedFrameRing::nowNs());
+        report.sent++;
+    } while (!hungUp && (o.full || !finished) && source->next(f));
+
+    // Let the last replies come in, then hang up; the service closes in turn.
+    auto giveUp = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (lastReplied + 1 < (int64_t)frame && !hungUp && std::chrono::steady_clock::now() < giveUp) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    shutdown(fd, SHUT_WR);
+    reader.join();
+    ::close(fd);
+    return true;
+}
+
+void logLatency(const std::string& what, std::vector<double> ms) {
+    if (ms.empty()) return;
+    ofLogNotice("ingest") << what << ": capture to reply p50 " << ofToString(stats::percentile(ms, 0.50), 2)
+                          << " ms, p95 " << ofToString(stats::percentile(ms, 0.95), 2)
+                          << " ms, p99 " << ofToString(stats::percentile(ms, 0.99), 2)
+                          << " ms, max " << ofToString(*std::max_element(ms.begin(), ms.end()), 2) << " ms";
+}
+
+} // namespace
+
+int serve(int argc, char* argv[]) {
+    Settings s;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if      (a == "--socket")       s.socketPath = value();
+        else if (a == "--model")        s.modelPath = value();
+        else if (a == "--detector")     s.detector = value();
+        else if (a == "--track-scale")  s.trackingScale = ofToFloat(value());
+        else if (a == "--infer-every")  s.inference.every = std::max(1, ofToInt(value()));
+        else if (a == "--no-gate")      s.gate.enabled = false;
+        else if (a == "--gate-sharpness") s.gate.minSharpness = ofToFloat(value());
+        else if (a == "--max-sessions") s.maxSessions = std::max(1, ofToInt(value()));
+        else if (a == "--track-slots")  s.trackSlots = std::max(1, ofToInt(value()));
+        else if (a == "--metrics-port") s.metrics.port = ofToInt(value());
+        else if (a == "--metrics-file") s.metrics.file = value();
+        else {
+            ofLogError("ingest") << "usage: --serve [--socket path] [--model p] [--detector name] [--track-scale f] "
+                                    "[--infer-every n] [--no-gate] [--gate-sharpness f] [--max-sessions n] "
+                                    "[--track-slots n] "
+                                    "[--metrics-port n] [--metrics-file path]";
+            return 2;
+        }
+    }
+    if (!detectors::make(s.detector)) {
+        ofLogError("ingest") << "usage: --detector hog[:threads]|haar|reuse[:name]";
+        return 2;
+    }
+    if (s.socketPath.size() >= sizeof(sockaddr_un::sun_path)) {
+        ofLogError("ingest") << "socket path too long: " << s.socketPath;
+        return 2;
+    }
+    auto model = LandmarkModel::shared(s.modelPath);
+    if (!model) return 1;
+
+    // A client that hangs up mid-reply ends its session, not the service.
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = socketAddress(s.socketPath);
+    unlink(s.socketPath.c_str()); // left behind by an earlier run
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 16) != 0) {
+        ofLogError("ingest") << "cannot listen on " << s.socketPath << ": " << std::strerror(errno);
+        if (listenFd >= 0) ::close(listenFd);
+        return 1;
+    }
+    ofLogNotice("ingest") << "listening on " << s.socketPath << ", " << s.maxSessions << " sessions, "
+                          << s.trackSlots << " tracking at a time";
+
+    metrics::Exporter exporter;
+    if (s.metrics.enabled()) exporter.start(s.metrics);
+    FairGate gate(s.trackSlots);
+    std::vector<std::unique_ptr<Session>> sessions;
+    int nextId = 1;
+    while (!stopRequested) {
+        sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                                      [](const std::unique_ptr<Session>& x) { return x->done(); }),
+                       sessions.end());
+        pollfd p{ listenFd, POLLIN, 0 };
+        if (poll(&p, 1, kAcceptMillis) <= 0) continue;
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) continue;
+        if ((int)sessions.size() >= s.maxSessions) {
+            sendLine(fd, "{\"error\":\"busy\"}");
+            ::close(fd);
+            continue;
+        }
+        sessions.push_back(std::make_unique<Session>(fd, nextId++, s, model, &gate));
+    }
+    for (auto& x : sessions) x->stop();
+    sessions.clear();
+    ::close(listenFd);
+    unlink(s.socketPath.c_str());
+    return 0;
+}
+
+int client(int argc, char* argv[]) {
+    ClientOptions o;
+    o.socketPath = Settings().socketPath;
+    int clients = 0;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if      (a == "--socket")  o.socketPath = value();
+        else if (a == "--clients") clients = std::max(1, ofToInt(value()));
+        else if (a == "--as-fast") o.asFast = true;
+        else if (a == "--full")    o.full = true;
+        else inputs.push_back(a);
+    }
+    auto clips = frames::collectClips(inputs);
+    if (clips.empty()) {
+        ofLogError("ingest") << "usage: --ingest-client [--socket path] [--clients n] [--as-fast] [--full] <clip|dir>...";
+        return 2;
+    }
+    if (clients == 0) clients = (int)clips.size();
+
+    std::vector<ClientReport> reports(clients);
+    std::vector<char> ok(clients, 0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < clients; ++i) {
+        threads.emplace_back([&, i]() { ok[i] = runClient(i, clips[i % clips.size()], o, reports[i]); });
+    }
+    for (auto& t : threads) t.join();
+
+    std::vector<double> all;
+    bool allOk = true;
+    for (int i = 0; i < clients; ++i) {
+        const ClientReport& r = reports[i];
+        allOk = allOk && ok[i];
+        if (!ok[i]) continue;
+        ofLogNotice("ingest") << "client " << i << " " << r.clip << ": " << r.sent << " frames sent, " << r.replies
+                              << " tracked, " << (r.verdict.empty() ? "no verdict" : r.verdict);
+        logLatency("client " + ofToString(i), r.latencyMs);
+        all.insert(all.end(), r.latencyMs.begin(), r.latencyMs.end());
+    }
+    if (clients > 1) logLatency("all clients", all);
+    return allOk ? 0 : 1;
+}
+
+} // namespace ingest
@@ -0,0 +1,53 @@
+#pragma once
+#include <string>
+#include "FaceTrackerAdapter.h"
+#include "Metrics.h"
+
+// Headless screening for frames another local process captures. A client
+// puts its frames in a SharedFrameRing and talks to the service over a Unix
+// domain socket, one JSON object per line. Each connection is a session of
+// its own, with its own tracker and flow on its own thread, reading the
+// frames straight out of the shared mapping; sessions share the landmark
+// model and take turns at tracking.
+//
+// Client to service:
+//   {"shm":"/name"}   first line: the ring to read
+//   {"cmd":"start"}   start a screening, as a key press does live
+//   {"cmd":"reset"}
+// Service to client:
+//   {"ok":true,"width":640,"height":480} or {"error":"..."}, after the first line
+//   {"frame":12,"capture_ns":...,"stage":"hold_still","progress":0.420,"intensity":0.0000,
+//    "asymmetry":0.0000,"face":true}   for every frame tracked
+//   {"frame":96,"verdict":"abnormal","intensity":0.2140,"asymmetry":0.3310}
+//                                     once a screening reaches its verdict
+// Closing the socket ends the session. Frames that arrive while a session
+// is busy are skipped; capture_ns is echoed so clients can time replies.
+namespace ingest {
+
+struct Settings {
+    std::string socketPath = "/tmp/smileflow.sock";
+    std::string modelPath = "model/shape_predictor_68_face_landmarks.dat";
+    std::string detector = "hog";  // see detectors::make
+    float trackingScale = 1.f;
+    FaceTrackerAdapter::InferencePolicy inference;
+    FrameGate::Settings gate;
+    int maxSessions = 8;
+    int trackSlots = 1;            // sessions tracking at the same time
+    metrics::Exporter::Settings metrics; // sessions report under station="ingest"
+};
+
+// Entry point for `--serve [--socket path] [--model p] [--detector name]
+// [--track-scale f] [--infer-every n] [--no-gate] [--gate-sharpness f]
+// [--max-sessions n] [--track-slots n] [--metrics-port n]
+// [--metrics-file path]`. Runs until
+// SIGINT or SIGTERM. Returns the exit code.
+int serve(int argc, char* argv[]);
+
+// Stand-in producer for testing the service: plays clips into rings at
+// their own frame rate (or as fast as the service takes them), starts a
+// screening on each and reports the verdicts and the time from capture to
+// reply. Entry point for `--ingest-client [--socket path] [--clients n]
+// [--as-fast] [--full] <clip|dir>...`.
+int client(int argc, char* argv[]);
+
+} // namespace ingest
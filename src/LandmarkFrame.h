@@ -0,0 +1,20 @@
+#pragma once
+#include "ofMain.h"
+#include <array>
+#include <cstdint>
+#include "Landmarks68.h"
+
+// One face's landmarks in fixed storage, so they can be copied and passed
+// through the per-frame pipeline without touching the heap.
+struct LandmarkFrame {
+    std::array<glm::vec2, LM_NUM_POINTS> points{};
+    uint64_t frame = 0; // index of the tracked frame the points came from
+
+    static constexpr size_t size() { return LM_NUM_POINTS; }
+    glm::vec2&       operator[](size_t i)       { return points[i]; }
+    const glm::vec2& operator[](size_t i) const { return points[i]; }
+    glm::vec2*       begin()       { return points.data(); }
+    glm::vec2*       end()         { return points.data() + LM_NUM_POINTS; }
+    const glm::vec2* begin() const { return points.data(); }
+    const glm::vec2* end()   const { return points.data() + LM_NUM_POINTS; }
+};
@@ -0,0 +1,461 @@
+#include "LandmarkModel.h"
+#include <dlib/opencv.h>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <future>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// .lmm layout: this header, then the sections below in order, each starting
+// on a 64-byte boundary. All trees of a model have the same depth, so every
+// size follows from the header.
+//   initial shape  float[2P]
+//   anchors        uint32[C][F]
+//   deltas         float[C][F][2]
+//   splits         {uint32 idx1, idx2; float thresh}[C][T][S]
+//   leaves         float[C][T][S+1][2P]
+// The .dat it was converted from is identified by size and modification
+// time, so a replaced .dat is not shadowed by a stale .lmm.
+struct ModelFileHeader {
+    char     magic[4] = { 'S', 'L', 'M', 'M' };
+    uint32_t version = 2;
+    uint32_t numPoints = LM_NUM_POINTS;
+    uint32_t cascades = 0;
+    uint32_t trees = 0;    // per cascade
+    uint32_t splits = 0;   // per tree
+    uint32_t features = 0; // per cascade
+    uint32_t reserved0 = 0;
+    uint64_t bytes = 0;    // whole file
+    uint64_t sourceBytes = 0;
+    int64_t  sourceMtime = 0; // seconds since the epoch
+    uint8_t  reserved[8] = {};
+};
+static_assert(sizeof(ModelFileHeader) == 64, "lmm header layout changed");
+
+const size_t kSplitBytes = 12;
+
+size_t align64(size_t n) { return (n + 63) & ~size_t(63); }
+
+struct Layout {
+    size_t initial, anchors, deltas, splits, leaves, bytes;
+};
+
+Layout layoutFor(const ModelFileHeader& h) {
+    const size_t p2 = 2 * size_t(h.numPoints);
+    Layout l;
+    l.initial = align64(sizeof(ModelFileHeader));
+    l.anchors = align64(l.initial + p2 * sizeof(float));
+    l.deltas  = align64(l.anchors + size_t(h.cascades) * h.features * sizeof(uint32_t));
+    l.splits  = align64(l.deltas + size_t(h.cascades) * h.features * 2 * sizeof(float));
+    l.leaves  = align64(l.splits + size_t(h.cascades) * h.trees * h.splits * kSplitBytes);
+    l.bytes   = l.leaves + size_t(h.cascades) * h.trees * (h.splits + 1) * p2 * sizeof(float);
+    return l;
+}
+
+// The members of dlib::shape_predictor, read in its serialization order.
+struct DlibModel {
+    dlib::matrix<float, 0, 1> initialShape;
+    std::vector<std::vector<dlib::impl::regression_tree>> forests;
+    std::vector<std::vector<unsigned long>> anchors;
+    std::vector<std::vector<dlib::vector<float, 2>>> deltas;
+};
+
+bool readDat(const std::string& path, DlibModel& m) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    try {
+        int version = 0;
+        dlib::deserialize(version, in);
+        if (version != 1) throw dlib::serialization_error("unexpected shape_predictor version");
+        dlib::deserialize(m.initialShape, in);
+        dlib::deserialize(m.forests, in);
+        dlib::deserialize(m.anchors, in);
+        dlib::deserialize(m.deltas, in);
+    } catch (const std::exception& e) {
+        ofLogError("LandmarkModel") << "cannot read " << path << ": " << e.what();
+        return false;
+    }
+    return true;
+}
+
+// Checks that every cascade and tree has the shape the header describes.
+bool uniform(const DlibModel& m, const ModelFileHeader& h) {
+    if (m.initialShape.size() != 2 * LM_NUM_POINTS) return false;
+    if (m.anchors.size() != h.cascades || m.deltas.size() != h.cascades) return false;
+    for (uint32_t c = 0; c < h.cascades; ++c) {
+        if (m.forests[c].size() != h.trees) return false;
+        if (m.anchors[c].size() != h.features || m.deltas[c].size() != h.features) return false;
+        for (const auto& tree : m.forests[c]) {
+            if (tree.splits.size() != h.splits || tree.leaf_values.size() != h.splits + 1) return false;
+            for (const auto& leaf : tree.leaf_values) {
+                if (leaf.size() != 2 * LM_NUM_POINTS) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Size and modification time of a file, false when it cannot be read.
+bool stamp(const std::string& path, uint64_t& bytes, int64_t& mtime) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) return false;
+    bytes = (uint64_t)st.st_size;
+    mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+} // namespace
+
+LandmarkModel::~LandmarkModel() {
+    if (data_) munmap(data_, bytes_);
+}
+
+std::string LandmarkModel::cachePath(const std::string& datPath) {
+    return ofFilePath::removeExt(datPath) + ".lmm";
+}
+
+std::shared_ptr<const LandmarkModel> LandmarkModel::load(const std::string& path) {
+    auto t0 = std::chrono::steady_clock::now();
+    auto model = std::make_shared<LandmarkModel>();
+    const std::string full = ofToDataPath(path, true);
+    const bool isLmm = ofFilePath::getFileExt(full) == "lmm";
+    const std::string lmm = isLmm ? full : cachePath(full);
+    if (isLmm || ofFile::doesFileExist(lmm, false)) {
+        if (model->map(lmm, isLmm ? std::string() : full)) {
+            ofLogNotice("LandmarkModel") << "mapped " << lmm << " in " << ofToString(secondsSince(t0) * 1000.0, 1) << " ms";
+            return model;
+        }
+        if (isLmm) return nullptr;
+    }
+
+    model->path_ = full;
+    try {
+        dlib::deserialize(model->path_) >> model->predictor_;
+    } catch (const std::exception& e) {
+        ofLogError("LandmarkModel") << "cannot load " << model->path_ << ": " << e.what();
+        return nullptr;
+    }
+    if (model->predictor_.num_parts() != LM_NUM_POINTS) {
+        ofLogError("LandmarkModel") << model->path_ << " is not a " << LM_NUM_POINTS << "-point model";
+        return nullptr;
+    }
+    ofLogNotice("LandmarkModel") << "parsed " << full << " in " << ofToString(secondsSince(t0), 2)
+                                 << " s; --convert-model writes " << lmm << " for a faster start";
+    return model;
+}
+
+std::shared_ptr<const LandmarkModel> LandmarkModel::shared(const std::string& path) {
+    using Ptr = std::shared_ptr<const LandmarkModel>;
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const LandmarkModel>> loaded;
+    static std::map<std::string, std::shared_future<Ptr>> loading;
+
+    const std::string key = ofToDataPath(path, true);
+    std::promise<Ptr> promise;
+    std::shared_future<Ptr> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = loaded.find(key);
+        if (it != loaded.end()) {
+            if (Ptr model = it->second.lock()) return model;
+        }
+        auto inFlight = loading.find(key);
+        if (inFlight != loading.end()) {
+            pending = inFlight->second;
+        } else {
+            loading[key] = promise.get_future().share();
+        }
+    }
+    if (pending.valid()) return pending.get();
+
+    // However load() leaves, the entry is dropped and the waiters get an
+    // answer; a throw reaches them as an exception of their own.
+    struct Finish {
+        const std::string& key;
+        std::promise<Ptr>& promise;
+        Ptr  model;
+        bool returned = false;
+        ~Finish() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (model) {
+                    for (auto it = loaded.begin(); it != loaded.end();) {
+                        it = it->second.expired() ? loaded.erase(it) : std::next(it);
+                    }
+                    loaded[key] = model;
+                }
+                loading.erase(key);
+            }
+            if (returned) promise.set_value(model);
+            else promise.set_exception(std::make_exception_ptr(std::runtime_error("loading " + key + " failed")));
+        }
+    } finish{ key, promise };
+    finish.model = load(path);
+    finish.returned = true;
+    return finish.model;
+}
+
+bool LandmarkModel::map(const std::string& path, const std::string& source) {
+    static_assert(sizeof(Split) == kSplitBytes, "split layout changed");
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ModelFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    const size_t bytes = (size_t)st.st_size;
+    // Shared and read-only: every process mapping the file uses the same pages.
+    void* data = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+    // Ask for the pages now; fits only touch a sixteenth of the leaves each,
+    // so faulting them in on demand would slow the first seconds of tracking.
+    madvise(data, bytes, MADV_WILLNEED);
+
+    const ModelFileHeader& h = *static_cast<const ModelFileHeader*>(data);
+    const Layout l = layoutFor(h);
+    if (std::memcmp(h.magic, "SLMM", 4) != 0 || h.version != 2 || h.numPoints != LM_NUM_POINTS ||
+        h.bytes != bytes || l.bytes != bytes) {
+        ofLogError("LandmarkModel") << path << ": not a version 2 mapped landmark model";
+        munmap(data, bytes);
+        return false;
+    }
+    uint64_t sourceBytes = 0;
+    int64_t  sourceMtime = 0;
+    if (!source.empty() && stamp(source, sourceBytes, sourceMtime) &&
+        (sourceBytes != h.sourceBytes || sourceMtime != h.sourceMtime)) {
+        ofLogWarning("LandmarkModel") << path << " was not converted from the current " << source
+                                      << "; using the .dat, --convert-model refreshes it";
+        munmap(data, bytes);
+        return false;
+    }
+    // fitMapped() indexes shapes by anchor and pixels by split without checks.
+    const char* base = static_cast<const char*>(data);
+    const uint32_t* anchors = reinterpret_cast<const uint32_t*>(base + l.anchors);
+    const Split*    splits  = reinterpret_cast<const Split*>(base + l.splits);
+    bool inRange = true;
+    for (size_t i = 0, n = size_t(h.cascades) * h.features; i < n && inRange; ++i) {
+        inRange = anchors[i] < h.numPoints;
+    }
+    for (size_t i = 0, n = size_t(h.cascades) * h.trees * h.splits; i < n && inRange; ++i) {
+        inRange = splits[i].idx1 < h.features && splits[i].idx2 < h.features;
+    }
+    if (!inRange) {
+        ofLogError("LandmarkModel") << path << ": anchor or split index out of range";
+        munmap(data, bytes);
+        return false;
+    }
+    data_  = data;
+    bytes_ = bytes;
+    path_  = path;
+    cascades_ = h.cascades;
+    trees_    = h.trees;
+    splits_   = h.splits;
+    features_ = h.features;
+    initialShape_ = reinterpret_cast<const float*>(base + l.initial);
+    anchors_      = anchors;
+    deltas_       = reinterpret_cast<const float*>(base + l.deltas);
+    splitNodes_   = splits;
+    leaves_       = reinterpret_cast<const float*>(base + l.leaves);
+    return true;
+}
+
+bool LandmarkModel::convert(const std::string& datPath, const std::string& lmmPath) {
+    auto t0 = std::chrono::steady_clock::now();
+    const std::string dat = ofToDataPath(datPath, true);
+    const std::string lmm = ofToDataPath(lmmPath, true);
+    DlibModel m;
+    if (!readDat(dat, m)) return false;
+
+    ModelFileHeader h;
+    h.cascades = (uint32_t)m.forests.size();
+    h.trees    = m.forests.empty() ? 0 : (uint32_t)m.forests[0].size();
+    h.splits   = h.trees == 0 ? 0 : (uint32_t)m.forests[0][0].splits.size();
+    h.features = m.anchors.empty() ? 0 : (uint32_t)m.anchors[0].size();
+    if (h.cascades == 0 || !uniform(m, h)) {
+        ofLogError("LandmarkModel") << dat << ": not a " << LM_NUM_POINTS << "-point model with uniform trees";
+        return false;
+    }
+    const Layout l = layoutFor(h);
+    h.bytes = l.bytes;
+    if (!stamp(dat, h.sourceBytes, h.sourceMtime)) {
+        ofLogError("LandmarkModel") << "cannot stat " << dat;
+        return false;
+    }
+
+    std::vector<char> buf(l.bytes, 0);
+    std::memcpy(buf.data(), &h, sizeof(h));
+    float* initial = reinterpret_cast<float*>(buf.data() + l.initial);
+    for (long i = 0; i < m.initialShape.size(); ++i) initial[i] = m.initialShape(i);
+    uint32_t* anchors = reinterpret_cast<uint32_t*>(buf.data() + l.anchors);
+    float*    deltas  = reinterpret_cast<float*>(buf.data() + l.deltas);
+    Split*    splits  = reinterpret_cast<Split*>(buf.data() + l.splits);
+    float*    leaves  = reinterpret_cast<float*>(buf.data() + l.leaves);
+    for (uint32_t c = 0; c < h.cascades; ++c) {
+        for (uint32_t f = 0; f < h.features; ++f) {
+            *anchors++ = (uint32_t)m.anchors[c][f];
+            *deltas++  = m.deltas[c][f].x();
+            *deltas++  = m.deltas[c][f].y();
+        }
+        for (const auto& tree : m.forests[c]) {
+            for (const auto& s : tree.splits) *splits++ = Split{ (uint32_t)s.idx1, (uint32_t)s.idx2, s.thresh };
+            for (const auto& leaf : tree.leaf_values) {
+                for (long i = 0; i < leaf.size(); ++i) *leaves++ = leaf(i);
+            }
+        }
+    }
+
+    // Written beside the target and renamed, so a process mapping the old
+    // file never sees a half-written one.
+    const std::string tmp = lmm + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out.write(buf.data(), buf.size())) {
+            ofLogError("LandmarkModel") << "cannot write " << tmp;
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), lmm.c_str()) != 0) {
+        ofLogError("LandmarkModel") << "cannot replace " << lmm;
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+    // Both predictors on the same smooth random images. Float rounding can
+    // flip the odd split and move a point by a pixel or two; a layout error
+    // moves all of them.
+    LandmarkModel reference, mapped;
+    try {
+        dlib::deserialize(dat) >> reference.predictor_;
+    } catch (const std::exception& e) {
+        ofLogError("LandmarkModel") << "cannot load " << dat << ": " << e.what();
+        return false;
+    }
+    if (!mapped.map(lmm, dat)) return false;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    cv::Mat img(240, 320, CV_8UC1);
+    LandmarkFrame a, b;
+    const int kImages = 8;
+    float maxDiff = 0.f, sumDiff = 0.f;
+    for (int n = 0; n < kImages; ++n) {
+        float fx = 0.02f + 0.1f * unit(rng), fy = 0.02f + 0.1f * unit(rng), phase = 6.f * unit(rng);
+        for (int y = 0; y < img.rows; ++y) {
+            unsigned char* row = img.ptr(y);
+            for (int x = 0; x < img.cols; ++x) {
+                row[x] = (unsigned char)(128.f + 70.f * std::sin(fx * x + phase) * std::cos(fy * y) + 50.f * std::sin(0.5f * fy * (x + y)));
+            }
+        }
+        dlib::rectangle box(80 + 4 * n, 40 + 2 * n, 240 - 2 * n, 200 - 4 * n);
+        reference.fit(img, box, a);
+        mapped.fit(img, box, b);
+        for (int i = 0; i < LM_NUM_POINTS; ++i) {
+            float d = glm::length(a[i] - b[i]);
+            maxDiff = std::max(maxDiff, d);
+            sumDiff += d;
+        }
+    }
+    const float meanDiff = sumDiff / (kImages * LM_NUM_POINTS);
+    if (meanDiff > 0.25f) {
+        ofLogError("LandmarkModel") << lmm << " disagrees with " << dat << " by " << meanDiff << " px on average; removed";
+        std::remove(lmm.c_str());
+        return false;
+    }
+    ofLogNotice("LandmarkModel") << "wrote " << lmm << " (" << l.bytes / (1024 * 1024) << " MB) in "
+                                 << ofToString(secondsSince(t0), 2) << " s; deviation from dlib " << meanDiff
+                                 << " px mean, " << maxDiff << " px max";
+    return true;
+}
+
+void LandmarkModel::fit(const cv::Mat& gray, const dlib::rectangle& box, LandmarkFrame& out) const {
+    if (mapped()) {
+        fitMapped(gray, box, out);
+        return;
+    }
+    dlib::full_object_detection shape = predictor_(dlib::cv_image<unsigned char>(gray), box);
+    for (int i = 0; i < LM_NUM_POINTS; ++i) out[i] = glm::vec2(shape.part(i).x(), shape.part(i).y());
+}
+
+// dlib's shape_predictor cascade on the mapped arrays. Shapes live in the
+// unit square of the box; each cascade samples pixels at offsets from anchor
+// points, carried along by the similarity between the reference and current
+// shape, and each tree adds the leaf its pixel-difference splits lead to.
+void LandmarkModel::fitMapped(const cv::Mat& gray, const dlib::rectangle& box, LandmarkFrame& out) const {
+    constexpr int kCoords = 2 * LM_NUM_POINTS;
+    std::array<float, kCoords> shape;
+    std::copy(initialShape_, initialShape_ + kCoords, shape.begin());
+    thread_local std::vector<float> pixels;
+    pixels.resize(features_);
+
+    // The reference shape, centered, for the similarity fit.
+    glm::vec2 refMean(0, 0);
+    for (int i = 0; i < LM_NUM_POINTS; ++i) refMean += glm::vec2(initialShape_[2 * i], initialShape_[2 * i + 1]);
+    refMean /= float(LM_NUM_POINTS);
+    float refNorm = 0.f;
+    for (int i = 0; i < LM_NUM_POINTS; ++i) {
+        glm::vec2 r = glm::vec2(initialShape_[2 * i], initialShape_[2 * i + 1]) - refMean;
+        refNorm += glm::dot(r, r);
+    }
+
+    // Unit square -> image, as dlib maps it onto the box corners.
+    const float left = (float)box.left(), top = (float)box.top();
+    const float w = float(box.right() - box.left()), h = float(box.bottom() - box.top());
+    const long maxX = gray.cols - 1, maxY = gray.rows - 1;
+    const size_t leafStride = size_t(splits_ + 1) * kCoords;
+
+    for (uint32_t c = 0; c < cascades_; ++c) {
+        // Least-squares scale and rotation from the reference to the current shape.
+        glm::vec2 curMean(0, 0);
+        for (int i = 0; i < LM_NUM_POINTS; ++i) curMean += glm::vec2(shape[2 * i], shape[2 * i + 1]);
+        curMean /= float(LM_NUM_POINTS);
+        float dotSum = 0.f, crossSum = 0.f;
+        for (int i = 0; i < LM_NUM_POINTS; ++i) {
+            glm::vec2 r = glm::vec2(initialShape_[2 * i], initialShape_[2 * i + 1]) - refMean;
+            glm::vec2 s = glm::vec2(shape[2 * i], shape[2 * i + 1]) - curMean;
+            dotSum   += r.x * s.x + r.y * s.y;
+            crossSum += r.x * s.y - r.y * s.x;
+        }
+        const float a = refNorm > 0.f ? dotSum / refNorm : 1.f;
+        const float b = refNorm > 0.f ? crossSum / refNorm : 0.f;
+
+        const uint32_t* anchor = anchors_ + size_t(c) * features_;
+        const float*    delta  = deltas_ + size_t(c) * features_ * 2;
+        for (uint32_t f = 0; f < features_; ++f) {
+            const float dx = delta[2 * f], dy = delta[2 * f + 1];
+            const float x = a * dx - b * dy + shape[2 * anchor[f]];
+            const float y = b * dx + a * dy + shape[2 * anchor[f] + 1];
+            const long ix = (long)std::floor(left + x * w + 0.5f);
+            const long iy = (long)std::floor(top + y * h + 0.5f);
+            pixels[f] = (ix >= 0 && iy >= 0 && ix <= maxX && iy <= maxY) ? (float)gray.ptr(iy)[ix] : 0.f;
+        }
+
+        const Split* split = splitNodes_ + size_t(c) * trees_ * splits_;
+        const float* leaf  = leaves_ + size_t(c) * trees_ * leafStride;
+        for (uint32_t t = 0; t < trees_; ++t, split += splits_, leaf += leafStride) {
+            uint32_t i = 0;
+            while (i < splits_) {
+                i = pixels[split[i].idx1] - pixels[split[i].idx2] > split[i].thresh ? 2 * i + 1 : 2 * i + 2;
+            }
+            const float* v = leaf + size_t(i - splits_) * kCoords;
+            for (int k = 0; k < kCoords; ++k) shape[k] += v[k];
+        }
+    }
+
+    for (int i = 0; i < LM_NUM_POINTS; ++i) {
+        out[i] = glm::vec2(std::floor(left + shape[2 * i] * w + 0.5f), std::floor(top + shape[2 * i + 1] * h + 0.5f));
+    }
+}
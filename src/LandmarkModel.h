@@ -0,0 +1,64 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxCv.h"
+#include <dlib/image_processing.h>
+#include <memory>
+#include <string>
+#include "LandmarkFrame.h"
+
+// The 68-point shape predictor. It is immutable once loaded, so one instance
+// can be shared by any number of trackers on any number of threads.
+//
+// Two on-disk forms are accepted: dlib's serialized .dat, which takes
+// seconds to parse, and a flat .lmm layout written by convert(), which is
+// memory-mapped read-only and so loads in milliseconds and is shared with
+// every other process using it through the page cache.
+class LandmarkModel {
+public:
+    LandmarkModel() = default;
+    LandmarkModel(const LandmarkModel&) = delete;
+    LandmarkModel& operator=(const LandmarkModel&) = delete;
+    ~LandmarkModel();
+
+    // For a .dat path the .lmm next to it (cachePath()) is used when present
+    // and converted from that very .dat; otherwise the .dat is parsed.
+    static std::shared_ptr<const LandmarkModel> load(const std::string& path);
+    // Process-wide registry over load(): everyone asking for the same file
+    // gets the same instance, which lives as long as someone holds it.
+    // Concurrent first requests wait for a single load. Failures are not
+    // remembered, so a later call tries again; if the load throws, those
+    // waiting get an exception too. Released models are forgotten.
+    static std::shared_ptr<const LandmarkModel> shared(const std::string& path);
+    // Writes datPath in the mapped layout, then checks that the mapped
+    // predictor places the points where dlib's does.
+    static bool convert(const std::string& datPath, const std::string& lmmPath);
+    static std::string cachePath(const std::string& datPath);
+
+    // Fits the points inside box on an 8-bit grayscale image; both in image coordinates.
+    void fit(const cv::Mat& gray, const dlib::rectangle& box, LandmarkFrame& out) const;
+
+    bool mapped() const { return data_ != nullptr; }
+    const std::string& path() const { return path_; }
+
+private:
+    // source: the .dat the file must have been converted from, or empty.
+    bool map(const std::string& path, const std::string& source);
+    void fitMapped(const cv::Mat& gray, const dlib::rectangle& box, LandmarkFrame& out) const;
+
+    dlib::shape_predictor predictor_;
+    std::string           path_;
+
+    // Mapped layout, see LandmarkModel.cpp.
+    struct Split {
+        uint32_t idx1, idx2;
+        float    thresh;
+    };
+    void*        data_ = nullptr;
+    size_t       bytes_ = 0;
+    uint32_t     cascades_ = 0, trees_ = 0, splits_ = 0, features_ = 0;
+    const float*    initialShape_ = nullptr; // 2 * LM_NUM_POINTS
+    const uint32_t* anchors_ = nullptr;      // [cascade][feature]
+    const float*    deltas_ = nullptr;       // [cascade][feature][2]
+    const Split*    splitNodes_ = nullptr;   // [cascade][tree][split]
+    const float*    leaves_ = nullptr;       // [cascade][tree][leaf][2 * LM_NUM_POINTS]
+};
@@ -0,0 +1,38 @@
+#include "LandmarkPredictor.h"
+#include "Math2D.h"
+
+void LandmarkPredictor::reset() {
+    have_ = false;
+    since_ = 0;
+    maxSpeed_ = 0.f;
+    vel_.fill(glm::vec2(0, 0));
+}
+
+void LandmarkPredictor::measure(const LandmarkFrame& pts) {
+    if (have_) {
+        const float frames = float(since_ + 1);
+        maxSpeed_ = 0.f;
+        for (int i = 0; i < LM_NUM_POINTS; ++i) {
+            glm::vec2 v = (pts[i] - lastMeasured_[i]) / frames;
+            vel_[i] += velocityGain * (v - vel_[i]);
+            maxSpeed_ = std::max(maxSpeed_, glm::length(vel_[i]));
+        }
+    }
+    glm::vec2 l(0, 0), r(0, 0);
+    for (int i = LM_LEFT_EYE_START;  i <= LM_LEFT_EYE_END;  ++i) l += pts[i];
+    for (int i = LM_RIGHT_EYE_START; i <= LM_RIGHT_EYE_END; ++i) r += pts[i];
+    iod_ = math2d::interOcular(l / 6.f, r / 6.f);
+
+    pos_ = pts;
+    lastMeasured_ = pts;
+    since_ = 0;
+    have_ = true;
+}
+
+void LandmarkPredictor::predict(LandmarkFrame& out) {
+    since_++;
+    for (int i = 0; i < LM_NUM_POINTS; ++i) {
+        pos_[i] += vel_[i];
+        out[i] = pos_[i];
+    }
+}
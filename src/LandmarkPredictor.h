@@ -0,0 +1,32 @@
+#pragma once
+#include "ofMain.h"
+#include <array>
+#include "LandmarkFrame.h"
+
+// Predicts landmarks for frames where the landmark model is skipped. Each
+// point moves at a constant velocity, in pixels per tracked frame, that is
+// re-estimated alpha-beta style at every measurement; measured points
+// themselves pass through untouched.
+class LandmarkPredictor {
+public:
+    float velocityGain = 0.6f; // weight of the newest velocity measurement
+
+    void reset();
+    bool ready() const { return have_; }
+    void measure(const LandmarkFrame& pts);
+    // Advances one frame and writes the prediction (out.frame is left alone).
+    void predict(LandmarkFrame& out);
+
+    int   framesSinceMeasure() const { return since_; }
+    // Fastest point's speed per frame relative to the inter-ocular distance.
+    float normalizedSpeed() const { return maxSpeed_ / iod_; }
+
+private:
+    LandmarkFrame pos_;
+    LandmarkFrame lastMeasured_;
+    std::array<glm::vec2, LM_NUM_POINTS> vel_{};
+    float iod_ = 1.f;
+    float maxSpeed_ = 0.f;
+    int   since_ = 0;
+    bool  have_ = false;
+};
@@ -0,0 +1,142 @@
+#include "LandmarkRecording.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+// How often the writer wakes to drain the ring.
+const auto kWriterInterval = std::chrono::milliseconds(20);
+}
+
+void fillRecord(LandmarkRecord& r, double time, bool hasFace, const LandmarkFrame* raw,
+                const DerolledData& der, bool sessionStart, bool measured) {
+    r.time  = time;
+    r.flags = 0;
+    if (!measured)    r.flags |= LandmarkRecord::UNMEASURED;
+    if (hasFace)      r.flags |= LandmarkRecord::HAS_FACE;
+    if (sessionStart) r.flags |= LandmarkRecord::SESSION_START;
+    if (raw) r.raw = *raw;
+    if (der.valid) {
+        r.flags |= LandmarkRecord::DEROLLED;
+        if (der.insideGuide) r.flags |= LandmarkRecord::INSIDE_GUIDE;
+        if (der.predicted)   r.flags |= LandmarkRecord::PREDICTED;
+        r.iod        = der.iod;
+        r.faceCenter = der.faceCenter;
+        r.derolled   = der.points;
+    } else {
+        r.iod        = 1.f;
+        r.faceCenter = glm::vec2(0, 0);
+    }
+}
+
+LandmarkRecorder::~LandmarkRecorder() {
+    close();
+}
+
+bool LandmarkRecorder::open(const std::string& path, int frameWidth, int frameHeight, size_t capacity) {
+    close();
+    file_ = std::fopen(ofToDataPath(path, true).c_str(), "wb");
+    if (!file_) {
+        ofLogError("LandmarkRecorder") << "cannot create " << path;
+        return false;
+    }
+    LandmarkFileHeader h;
+    h.recordSize  = sizeof(LandmarkRecord);
+    h.frameWidth  = frameWidth;
+    h.frameHeight = frameHeight;
+    std::fwrite(&h, sizeof(h), 1, file_);
+
+    ring_.resize(std::max<size_t>(capacity, 1));
+    head_ = 0;
+    tail_ = 0;
+    dropped_ = 0;
+    stop_ = false;
+    writer_ = std::thread(&LandmarkRecorder::writerLoop, this);
+    return true;
+}
+
+void LandmarkRecorder::close() {
+    if (!file_) return;
+    stop_ = true;
+    if (writer_.joinable()) writer_.join();
+    std::fclose(file_);
+    file_ = nullptr;
+    if (dropped_ > 0) ofLogWarning("LandmarkRecorder") << dropped_ << " records dropped, writer fell behind";
+}
+
+LandmarkRecord& LandmarkRecorder::next() {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    full_ = head - tail_.load(std::memory_order_acquire) >= ring_.size();
+    return full_ ? scratch_ : ring_[head % ring_.size()];
+}
+
+void LandmarkRecorder::commit() {
+    if (full_) {
+        dropped_++;
+        return;
+    }
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void LandmarkRecorder::writerLoop() {
+    const size_t cap = ring_.size();
+    while (true) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        if (tail == head) {
+            if (stop_) break;
+            std::this_thread::sleep_for(kWriterInterval);
+            continue;
+        }
+        // One write per contiguous run, up to the end of the ring.
+        size_t first = tail % cap;
+        size_t n = std::min<size_t>(head - tail, cap - first);
+        std::fwrite(&ring_[first], sizeof(LandmarkRecord), n, file_);
+        tail_.store(tail + n, std::memory_order_release);
+    }
+    std::fflush(file_);
+}
+
+MappedLandmarkFile::~MappedLandmarkFile() {
+    close();
+}
+
+bool MappedLandmarkFile::open(const std::string& path) {
+    close();
+    int fd = ::open(ofToDataPath(path, true).c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(LandmarkFileHeader)) {
+        ::close(fd);
+        return false;
+    }
+    bytes_ = (size_t)st.st_size;
+    data_ = mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+        data_ = nullptr;
+        return false;
+    }
+
+    const LandmarkFileHeader& h = header();
+    if (std::memcmp(h.magic, "SLMK", 4) != 0 || h.version != 1 ||
+        h.recordSize != sizeof(LandmarkRecord) || h.numPoints != LM_NUM_POINTS) {
+        ofLogError("MappedLandmarkFile") << path << ": not a version 1 landmark stream";
+        close();
+        return false;
+    }
+    madvise(data_, bytes_, MADV_SEQUENTIAL);
+    records_ = reinterpret_cast<const LandmarkRecord*>(static_cast<const char*>(data_) + sizeof(LandmarkFileHeader));
+    count_ = (bytes_ - sizeof(LandmarkFileHeader)) / sizeof(LandmarkRecord);
+    return true;
+}
+
+void MappedLandmarkFile::close() {
+    if (data_) munmap(data_, bytes_);
+    data_ = nullptr;
+    bytes_ = 0;
+    records_ = nullptr;
+    count_ = 0;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "ofMain.h"
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "FaceTrackerAdapter.h"
+#include "LandmarkFrame.h"
+
+// Landmark stream files (.lmk): a 64-byte header followed by fixed-size
+// records, one per tracked frame, appended as they are produced. Records
+// are stored exactly as in memory (little-endian, packed floats) so a
+// replay can map the file and hand records to SmileFlow without copying.
+// A file cut short by a crash is still readable up to its last whole record.
+
+struct LandmarkFileHeader {
+    char     magic[4] = { 'S', 'L', 'M', 'K' };
+    uint32_t version = 1;
+    uint32_t recordSize = 0;
+    uint32_t numPoints = LM_NUM_POINTS;
+    int32_t  frameWidth = 0;
+    int32_t  frameHeight = 0;
+    uint8_t  reserved[40] = {};
+};
+
+struct LandmarkRecord {
+    enum Flags : uint32_t {
+        HAS_FACE      = 1 << 0,
+        DEROLLED      = 1 << 1, // derolled, iod and faceCenter are valid
+        INSIDE_GUIDE  = 1 << 2,
+        SESSION_START = 1 << 3, // first frame after SmileFlow::reset()
+        PREDICTED     = 1 << 4, // raw points extrapolated, not measured
+        UNMEASURED    = 1 << 5, // rejected by the frame gate, nothing tracked
+    };
+    double    time = 0.0;  // capture timestamp, seconds
+    uint32_t  flags = 0;
+    float     iod = 1.f;
+    glm::vec2 faceCenter{0,0};
+    LandmarkFrame raw;      // image coordinates; raw.frame is the frame index
+    LandmarkFrame derolled;
+};
+
+static_assert(sizeof(LandmarkFileHeader) == 64, "lmk header layout changed");
+static_assert(sizeof(LandmarkRecord) == 1128, "lmk record layout changed; bump the version");
+static_assert(std::is_trivially_copyable<LandmarkRecord>::value, "records are written and mapped raw");
+
+// Fills r from one tracked frame. raw may be null when there is no face.
+void fillRecord(LandmarkRecord& r, double time, bool hasFace, const LandmarkFrame* raw,
+                const DerolledData& der, bool sessionStart, bool measured = true);
+
+// Appends records from one producer thread without blocking it: next() hands
+// out a slot in a ring that a background thread drains to disk. If the
+// writer falls a whole ring behind, the record is dropped and counted.
+class LandmarkRecorder {
+public:
+    ~LandmarkRecorder();
+
+    bool open(const std::string& path, int frameWidth, int frameHeight, size_t capacity = 512);
+    // Drains the queue, then closes the file.
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+
+    LandmarkRecord& next();
+    void commit();
+
+    uint64_t written() const { return tail_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    void writerLoop();
+
+    FILE* file_ = nullptr;
+    std::vector<LandmarkRecord> ring_;
+    LandmarkRecord        scratch_;      // target of next() while the ring is full
+    bool                  full_ = false;
+    uint64_t              dropped_ = 0;
+    std::atomic<uint64_t> head_{0};      // producer
+    std::atomic<uint64_t> tail_{0};      // writer
+    std::atomic<bool>     stop_{false};
+    std::thread           writer_;
+};
+
+// Read-only memory mapping of one .lmk file.
+class MappedLandmarkFile {
+public:
+    MappedLandmarkFile() = default;
+    MappedLandmarkFile(const MappedLandmarkFile&) = delete;
+    MappedLandmarkFile& operator=(const MappedLandmarkFile&) = delete;
+    ~MappedLandmarkFile();
+
+    bool open(const std::string& path);
+    void close();
+
+    const LandmarkFileHeader& header() const { return *reinterpret_cast<const LandmarkFileHeader*>(data_); }
+    size_t size() const { return count_; }
+    const LandmarkRecord* begin() const { return records_; }
+    const LandmarkRecord* end() const   { return records_ + count_; }
+    const LandmarkRecord& operator[](size_t i) const { return records_[i]; }
+
+private:
+    void*  data_ = nullptr;
+    size_t bytes_ = 0;
+    const LandmarkRecord* records_ = nullptr;
+    size_t count_ = 0;
+};
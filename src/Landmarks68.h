@@ -1,8 +1,23 @@
 #pragma once
 // dlib 68-point landmark indices
+static constexpr int LM_NUM_POINTS = 68;
+static constexpr int LM_JAW_START       = 0;
+static constexpr int LM_JAW_END         = 16;
+static constexpr int LM_LEFT_BROW_START  = 17;
+static constexpr int LM_LEFT_BROW_END    = 21;
+static constexpr int LM_RIGHT_BROW_START = 22;
+static constexpr int LM_RIGHT_BROW_END   = 26;
+static constexpr int LM_NOSE_BRIDGE_START = 27;
+static constexpr int LM_NOSE_BRIDGE_END   = 30;
+static constexpr int LM_NOSE_BASE_START   = 31;
+static constexpr int LM_NOSE_BASE_END     = 35;
 static constexpr int LM_LEFT_EYE_START  = 36;
 static constexpr int LM_LEFT_EYE_END    = 41;
 static constexpr int LM_RIGHT_EYE_START = 42;
 static constexpr int LM_RIGHT_EYE_END   = 47;
+static constexpr int LM_OUTER_MOUTH_START = 48;
+static constexpr int LM_OUTER_MOUTH_END   = 59;
+static constexpr int LM_INNER_MOUTH_START = 60;
+static constexpr int LM_INNER_MOUTH_END   = 67;
 static constexpr int LM_LEFT_MOUTH_CORNER  = 48;
 static constexpr int LM_RIGHT_MOUTH_CORNER = 54;
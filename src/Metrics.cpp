@@ -0,0 +1,286 @@
+#include "Metrics.h"
+#include "ofMain.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace metrics {
+namespace {
+
+// How often the exporter thread looks for a stop request.
+const int kPollMillis = 200;
+// How long a scrape may take to send its request line.
+const int kRequestMillis = 1000;
+
+#ifdef MSG_NOSIGNAL
+const int kSendFlags = MSG_NOSIGNAL;
+#else
+const int kSendFlags = 0; // SO_NOSIGPIPE is set on the socket instead
+#endif
+
+std::string escape(const std::string& s, bool quotes) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (c == '\\')                 out += "\\\\";
+        else if (c == '\n')            out += "\\n";
+        else if (c == '"' && quotes)   out += "\\\"";
+        else                           out += c;
+    }
+    return out;
+}
+
+std::string renderLabels(const Labels& labels) {
+    std::string out;
+    for (const auto& l : labels) {
+        if (!out.empty()) out += ',';
+        out += l.first + "=\"" + escape(l.second, true) + "\"";
+    }
+    return out;
+}
+
+std::string number(double v) {
+    if (std::isnan(v)) return "NaN";
+    if (std::isinf(v)) return v > 0 ? "+Inf" : "-Inf";
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", v);
+    return buf;
+}
+
+// name{labels[,extra]} value
+void appendSample(std::string& out, const std::string& name, const std::string& labels, const std::string& extra,
+                  const std::string& value) {
+    out += name;
+    if (!labels.empty() || !extra.empty()) {
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extra.empty()) out += ',';
+        out += extra;
+        out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+
+bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, kSendFlags);
+        if (n <= 0) return false;
+        sent += (size_t)n;
+    }
+    return true;
+}
+} // namespace
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)), buckets_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+    std::sort(bounds_.begin(), bounds_.end());
+    for (size_t i = 0; i <= bounds_.size(); ++i) buckets_[i].store(0, std::memory_order_relaxed);
+}
+
+void Histogram::observe(double v) {
+    // A dozen bounds: a linear scan beats a binary search.
+    size_t i = 0;
+    while (i < bounds_.size() && v > bounds_[i]) ++i;
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    double s = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(s, s + v, std::memory_order_relaxed)) {}
+}
+
+uint64_t Histogram::count() const {
+    uint64_t n = 0;
+    for (size_t i = 0; i <= bounds_.size(); ++i) n += bucket(i);
+    return n;
+}
+
+const std::vector<double>& frameSecondsBounds() {
+    static const std::vector<double> bounds = { 0.001, 0.002, 0.005, 0.01, 0.02, 0.033, 0.05, 0.1, 0.2, 0.5, 1.0 };
+    return bounds;
+}
+
+Registry& Registry::global() {
+    static Registry r;
+    return r;
+}
+
+Registry::Series* Registry::find(const std::string& name, const std::string& help, Type type, const Labels& labels) {
+    const std::string rendered = renderLabels(labels);
+    auto f = std::find_if(families_.begin(), families_.end(), [&](const Family& x) { return x.name == name; });
+    if (f == families_.end()) {
+        families_.push_back(Family{ name, help, type, {} });
+        f = families_.end() - 1;
+    } else if (f->type != type) {
+        ofLogError("metrics") << name << " is already registered as another type";
+        return nullptr;
+    }
+    for (auto& s : f->series) {
+        if (s.labels == rendered) return &s;
+    }
+    f->series.push_back(Series{ rendered });
+    return &f->series.back();
+}
+
+// A series registered under the wrong type still gets somewhere to count,
+// it just is not exported.
+Counter& Registry::counter(const std::string& name, const std::string& help, const Labels& labels, double unit) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series* s = find(name, help, COUNTER, labels);
+    if (!s) return counters_.emplace_back();
+    if (!s->counter) {
+        s->counter = &counters_.emplace_back();
+        s->unit = unit;
+    }
+    return *s->counter;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& help, const Labels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series* s = find(name, help, GAUGE, labels);
+    if (!s) return gauges_.emplace_back();
+    if (!s->gauge) s->gauge = &gauges_.emplace_back();
+    return *s->gauge;
+}
+
+Histogram& Registry::histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                               const Labels& labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series* s = find(name, help, HISTOGRAM, labels);
+    if (!s) return histograms_.emplace_back(bounds);
+    if (!s->histogram) s->histogram = &histograms_.emplace_back(bounds);
+    return *s->histogram;
+}
+
+std::string Registry::render() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    for (const Family& f : families_) {
+        static const char* kTypes[] = { "counter", "gauge", "histogram" };
+        out += "# HELP " + f.name + " " + escape(f.help, false) + "\n";
+        out += "# TYPE " + f.name + " " + kTypes[f.type] + "\n";
+        for (const Series& s : f.series) {
+            if (s.counter) {
+                const uint64_t v = s.counter->value();
+                appendSample(out, f.name, s.labels, "", s.unit == 1.0 ? std::to_string(v) : number(v * s.unit));
+            } else if (s.gauge) {
+                appendSample(out, f.name, s.labels, "", number(s.gauge->value()));
+            } else if (s.histogram) {
+                const Histogram& h = *s.histogram;
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i <= h.bounds().size(); ++i) {
+                    cumulative += h.bucket(i);
+                    const std::string le = i < h.bounds().size() ? number(h.bounds()[i]) : "+Inf";
+                    appendSample(out, f.name + "_bucket", s.labels, "le=\"" + le + "\"", std::to_string(cumulative));
+                }
+                appendSample(out, f.name + "_sum", s.labels, "", number(h.sum()));
+                appendSample(out, f.name + "_count", s.labels, "", std::to_string(cumulative));
+            }
+        }
+    }
+    return out;
+}
+
+bool Registry::write(const std::string& path) const {
+    const std::string text = render();
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "w");
+    if (!f) return false;
+    bool ok = std::fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = std::fclose(f) == 0 && ok;
+    return ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+Exporter::~Exporter() {
+    stop();
+}
+
+bool Exporter::start(const Settings& s, const Registry& registry) {
+    stop();
+    settings_ = s;
+    registry_ = &registry;
+    if (s.port > 0) {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)s.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (listenFd_ < 0 || bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd_, 8) != 0) {
+            ofLogError("metrics") << "cannot listen on 127.0.0.1:" << s.port << ": " << std::strerror(errno);
+            if (listenFd_ >= 0) ::close(listenFd_);
+            listenFd_ = -1;
+            return false;
+        }
+        ofLogNotice("metrics") << "serving http://127.0.0.1:" << s.port << "/metrics";
+    }
+    if (!s.file.empty()) ofLogNotice("metrics") << "writing " << s.file << " every " << s.interval << " s";
+    stop_ = false;
+    thread_ = std::thread(&Exporter::loop, this);
+    return true;
+}
+
+void Exporter::stop() {
+    if (!thread_.joinable()) return;
+    stop_ = true;
+    thread_.join();
+    if (listenFd_ >= 0) ::close(listenFd_);
+    listenFd_ = -1;
+    // The final figures, so a short run still leaves a file behind.
+    if (!settings_.file.empty()) registry_->write(settings_.file);
+}
+
+void Exporter::loop() {
+    auto nextWrite = std::chrono::steady_clock::now();
+    while (!stop_) {
+        if (!settings_.file.empty() && std::chrono::steady_clock::now() >= nextWrite) {
+            if (!registry_->write(settings_.file)) ofLogWarning("metrics") << "cannot write " << settings_.file;
+            nextWrite += std::chrono::milliseconds((int)(1000 * std::max(0.1f, settings_.interval)));
+        }
+        if (listenFd_ < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kPollMillis));
+            continue;
+        }
+        pollfd p{ listenFd_, POLLIN, 0 };
+        if (poll(&p, 1, kPollMillis) <= 0) continue;
+        int fd = accept(listenFd_, nullptr, nullptr);
+        if (fd < 0) continue;
+#ifdef SO_NOSIGPIPE
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+        respond(fd);
+        ::close(fd);
+    }
+}
+
+// One request per connection; scrapes come every few seconds at most.
+void Exporter::respond(int fd) {
+    std::string request;
+    char chunk[1024];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kRequestMillis);
+    while (request.find("\r\n") == std::string::npos && request.size() < 8192) {
+        int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        pollfd p{ fd, POLLIN, 0 };
+        if (left <= 0 || poll(&p, 1, left) <= 0) return;
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return;
+        request.append(chunk, (size_t)n);
+    }
+    const bool scrape = request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 13, "GET /metrics?") == 0;
+    const std::string body = scrape ? registry_->render() : "not found\n";
+    sendAll(fd, std::string(scrape ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n") +
+                    "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                    "Connection: close\r\n\r\n" + body);
+}
+
+} // namespace metrics
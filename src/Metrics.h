@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Process-wide counters, gauges and histograms for fleet monitoring,
+// exposed in the Prometheus text format. Registering a series takes a lock
+// and belongs in setup; the reference it returns lives as long as the
+// process, and updating it is a relaxed atomic operation any thread may do
+// without ever waiting. Only rendering takes the lock again.
+namespace metrics {
+
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+class Counter {
+public:
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+class Gauge {
+public:
+    void set(double v) { value_.store(v, std::memory_order_relaxed); }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+private:
+    std::atomic<double> value_{0.0};
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<double>::is_always_lock_free,
+              "metric updates must not lock");
+
+// Fixed, ascending upper bounds plus an implicit +Inf bucket.
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+    void observe(double v);
+    const std::vector<double>& bounds() const { return bounds_; }
+    // Observations in bucket i alone, not cumulative; i == bounds().size() is +Inf.
+    uint64_t bucket(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    uint64_t count() const;
+    double   sum() const { return sum_.load(std::memory_order_relaxed); }
+private:
+    std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<double> sum_{0.0};
+};
+
+// Bucket bounds for per-frame durations, seconds.
+const std::vector<double>& frameSecondsBounds();
+
+class Registry {
+public:
+    static Registry& global();
+
+    // The same name and labels give the same series. A counter's raw
+    // increments are worth `unit` each in the exposition, e.g. 1e-6 for a
+    // seconds counter fed whole microseconds.
+    Counter&   counter(const std::string& name, const std::string& help, const Labels& labels = {},
+                       double unit = 1.0);
+    Gauge&     gauge(const std::string& name, const std::string& help, const Labels& labels = {});
+    Histogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                         const Labels& labels = {});
+
+    // Text exposition format 0.0.4, families in registration order.
+    std::string render() const;
+    // Replaces path in one rename, so a reader never sees half a file.
+    bool write(const std::string& path) const;
+
+private:
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+    struct Series {
+        std::string labels; // rendered, without braces
+        double      unit = 1.0;
+        Counter*    counter = nullptr;
+        Gauge*      gauge = nullptr;
+        Histogram*  histogram = nullptr;
+    };
+    struct Family {
+        std::string name, help;
+        Type        type;
+        std::vector<Series> series;
+    };
+    Series* find(const std::string& name, const std::string& help, Type type, const Labels& labels);
+
+    mutable std::mutex     mutex_;
+    std::vector<Family>    families_;
+    std::deque<Counter>    counters_;   // deques: growing never moves a series
+    std::deque<Gauge>      gauges_;
+    std::deque<Histogram>  histograms_;
+};
+
+// Serves a registry to Prometheus on localhost and/or rewrites it to a file
+// (for a node exporter's textfile collector), from a thread of its own.
+class Exporter {
+public:
+    struct Settings {
+        int         port = 0;       // 0: no HTTP endpoint; bound to 127.0.0.1 only
+        std::string file;           // non-empty: rewritten every interval
+        float       interval = 10.f; // seconds
+        bool enabled() const { return port > 0 || !file.empty(); }
+    };
+
+    ~Exporter();
+    bool start(const Settings& s, const Registry& registry = Registry::global());
+    void stop();
+
+private:
+    void loop();
+    void respond(int fd);
+
+    Settings          settings_;
+    const Registry*   registry_ = nullptr;
+    int               listenFd_ = -1;
+    std::atomic<bool> stop_{false};
+    std::thread       thread_;
+};
+
+} // namespace metrics
@@ -0,0 +1,148 @@
+#include "Profiler.h"
+
+#if STROKE_PROFILE
+#include "ofMain.h"
+#include <fstream>
+
+namespace prof {
+namespace {
+Histogram             g_hist[NUM_STAGES];
+std::atomic<uint64_t> g_newFrames{0};
+std::atomic<uint64_t> g_dupFrames{0};
+std::atomic<uint64_t> g_droppedFrames{0};
+
+int highestBit(uint64_t v) {
+    int b = 0;
+    while (v >>= 1) ++b;
+    return b;
+}
+} // namespace
+
+const char* stageName(Stage s) {
+    switch (s) {
+        case GRAB:     return "grab";
+        case DETECT:   return "detect";
+        case LANDMARK: return "landmark";
+        case DEROLL:   return "deroll";
+        case FLOW:     return "flow";
+        case DRAW:     return "draw";
+        case FRAME:    return "frame";
+        default:       return "unknown";
+    }
+}
+
+Histogram::Histogram() {
+    reset();
+}
+
+int Histogram::bucketOf(uint64_t us) {
+    const uint64_t sub = 1u << kSubBits;
+    us = std::min<uint64_t>(us, (1ull << kMaxBits) - 1);
+    if (us < sub) return (int)us;
+    int msb = highestBit(us);
+    int group = msb - kSubBits + 1;
+    return (group << kSubBits) | (int)((us >> (msb - kSubBits)) & (sub - 1));
+}
+
+uint64_t Histogram::bucketMid(int idx) {
+    const int sub = 1 << kSubBits;
+    if (idx < sub) return (uint64_t)idx;
+    int group = idx >> kSubBits;
+    uint64_t lo = (uint64_t)(sub | (idx & (sub - 1))) << (group - 1);
+    return lo + ((1ull << (group - 1)) >> 1);
+}
+
+void Histogram::record(uint64_t us) {
+    buckets_[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t prev = max_.load(std::memory_order_relaxed);
+    while (us > prev && !max_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+}
+
+double Histogram::percentile(double p) const {
+    uint64_t total = count();
+    if (total == 0) return 0.0;
+    uint64_t rank = (uint64_t)std::ceil(p * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) return (double)std::min(bucketMid(i), max());
+    }
+    return (double)max();
+}
+
+void Histogram::reset() {
+    for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+Histogram& histogram(Stage s) {
+    return g_hist[s];
+}
+
+void countFrame(bool isNew) {
+    (isNew ? g_newFrames : g_dupFrames).fetch_add(1, std::memory_order_relaxed);
+}
+
+void countDropped() {
+    g_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string overlayText() {
+    auto ms = [](double us) { return ofToString(us / 1000.0, 2); };
+    std::string s = "frames new " + ofToString(g_newFrames.load()) +
+                    "  dup " + ofToString(g_dupFrames.load()) +
+                    "  dropped " + ofToString(g_droppedFrames.load()) + "\n";
+    s += "stage      p50    p95    p99    max (ms)\n";
+    for (int i = 0; i < NUM_STAGES; ++i) {
+        const Histogram& h = g_hist[i];
+        s += ofToString(stageName((Stage)i), 8, ' ') + " " +
+             ofToString(ms(h.percentile(0.50)), 6, ' ') + " " +
+             ofToString(ms(h.percentile(0.95)), 6, ' ') + " " +
+             ofToString(ms(h.percentile(0.99)), 6, ' ') + " " +
+             ofToString(ms((double)h.max()), 6, ' ') + "\n";
+    }
+    return s;
+}
+
+bool dumpJson(const std::string& path) {
+    ofJson stages = ofJson::object();
+    for (int i = 0; i < NUM_STAGES; ++i) {
+        const Histogram& h = g_hist[i];
+        stages[stageName((Stage)i)] = {
+            { "count",  h.count() },
+            { "p50_us", h.percentile(0.50) },
+            { "p95_us", h.percentile(0.95) },
+            { "p99_us", h.percentile(0.99) },
+            { "max_us", h.max() }
+        };
+    }
+    ofJson j = {
+        { "time_s",         ofGetElapsedTimef() },
+        { "frames_new",     g_newFrames.load() },
+        { "frames_dup",     g_dupFrames.load() },
+        { "frames_dropped", g_droppedFrames.load() },
+        { "stages",         stages }
+    };
+    return ofSavePrettyJson(path, j);
+}
+
+bool dumpCsv(const std::string& path) {
+    std::ofstream out(ofToDataPath(path, true));
+    if (!out) return false;
+    out << "stage,count,p50_us,p95_us,p99_us,max_us\n";
+    for (int i = 0; i < NUM_STAGES; ++i) {
+        const Histogram& h = g_hist[i];
+        out << stageName((Stage)i) << "," << h.count() << ","
+            << h.percentile(0.50) << "," << h.percentile(0.95) << ","
+            << h.percentile(0.99) << "," << h.max() << "\n";
+    }
+    out << "frames_new," << g_newFrames.load() << "\n";
+    out << "frames_dup," << g_dupFrames.load() << "\n";
+    out << "frames_dropped," << g_droppedFrames.load() << "\n";
+    return true;
+}
+
+} // namespace prof
+#endif
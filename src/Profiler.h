@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Per-stage frame timing. Only built when STROKE_PROFILE is non-zero (the
+// debug configurations set it); otherwise the PROFILE_* macros expand to
+// nothing and none of this is compiled in.
+#ifndef STROKE_PROFILE
+#define STROKE_PROFILE 0
+#endif
+
+namespace prof {
+
+enum Stage { GRAB = 0, DETECT, LANDMARK, DEROLL, FLOW, DRAW, FRAME, NUM_STAGES };
+
+#if STROKE_PROFILE
+
+const char* stageName(Stage s);
+
+// Log-linear histogram of durations in microseconds: 8 sub-buckets per power
+// of two, so reported percentiles are within ~6% of the true value.
+// record() is wait-free and may be called from any thread.
+class Histogram {
+public:
+    Histogram();
+    void     record(uint64_t us);
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t max() const   { return max_.load(std::memory_order_relaxed); }
+    double   percentile(double p) const; // microseconds
+    void     reset();
+
+private:
+    static constexpr int kSubBits = 3;
+    static constexpr int kMaxBits = 40;
+    static constexpr int kBuckets = (kMaxBits - kSubBits + 1) << kSubBits;
+    static int      bucketOf(uint64_t us);
+    static uint64_t bucketMid(int idx);
+
+    std::atomic<uint64_t> buckets_[kBuckets];
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+Histogram& histogram(Stage s);
+
+// Render ticks that showed a new camera frame, ticks that re-showed the last
+// one, and camera frames replaced before the tracker could take them.
+void countFrame(bool isNew);
+void countDropped();
+
+std::string overlayText();
+bool dumpJson(const std::string& path);
+bool dumpCsv(const std::string& path);
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Stage s) : stage_(s), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+        histogram(stage_).record((uint64_t)us);
+    }
+private:
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage)  prof::ScopedTimer PROFILE_CONCAT(profScope_, __LINE__)(stage)
+#define PROFILE_FRAME(isNew)  prof::countFrame(isNew)
+#define PROFILE_DROPPED()     prof::countDropped()
+
+#else
+
+#define PROFILE_SCOPE(stage)  ((void)0)
+#define PROFILE_FRAME(isNew)  ((void)0)
+#define PROFILE_DROPPED()     ((void)0)
+
+#endif
+
+} // namespace prof
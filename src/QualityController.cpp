@@ -0,0 +1,80 @@
+#include "QualityController.h"
+
+std::vector<QualityController::Level> QualityController::defaultLevels() {
+    return {
+        { 1.f,   8,  1 },
+        { 0.75f, 8,  1 },
+        { 0.75f, 16, 2 },
+        { 0.5f,  16, 2 },
+        { 0.5f,  24, 3 },
+    };
+}
+
+void QualityController::setup(const Settings& s) {
+    s_ = s;
+    s_.windowFrames = std::max(1, s_.windowFrames);
+    level_ = 0;
+    sum_ = 0.0;
+    count_ = 0;
+    lastMean_ = 0.0;
+    sinceChange_ = 0;
+    cheapFrames_ = 0;
+    steadyFrames_ = 0;
+    backoff_ = 1;
+    lastWasUp_ = false;
+}
+
+bool QualityController::update(double trackerSeconds) {
+    if (!enabled()) return false;
+    sum_ += trackerSeconds;
+    sinceChange_++;
+    steadyFrames_++;
+    if (++count_ < s_.windowFrames) return false;
+
+    lastMean_ = sum_ / count_;
+    cheapFrames_ = lastMean_ < s_.budgetSeconds * s_.upAt ? cheapFrames_ + count_ : 0;
+    sum_ = 0.0;
+    count_ = 0;
+    // A long spell at one level is evidence the budget is no longer on the fence.
+    if (steadyFrames_ >= s_.backoffDecayFrames && backoff_ > 1) {
+        backoff_ /= 2;
+        steadyFrames_ = 0;
+    }
+
+    const int last = (int)s_.levels.size() - 1;
+    if (lastMean_ > s_.budgetSeconds * s_.downAt && level_ < last) {
+        // Undoing a step up right away means the budget sits between the two.
+        if (lastWasUp_ && sinceChange_ <= s_.windowFrames) backoff_ = std::min(backoff_ * 2, s_.maxBackoff);
+        change(level_ + 1, "over budget");
+        return true;
+    }
+    if (level_ > 0 && cheapFrames_ >= s_.upDwellFrames * backoff_) {
+        change(level_ - 1, "headroom");
+        return true;
+    }
+    return false;
+}
+
+void QualityController::change(int to, const char* why) {
+    ofLogNotice("QualityController") << "level " << level_ << " -> " << to << " (" << why << "): mean "
+                                     << lastMean_ * 1000.0 << " ms, budget " << s_.budgetSeconds * 1000.0
+                                     << " ms; scale " << s_.levels[to].trackingScale << ", full frame every "
+                                     << s_.levels[to].fullFrameEvery << ", infer every " << s_.levels[to].inferEvery;
+    lastWasUp_ = to < level_;
+    level_ = to;
+    sinceChange_ = 0;
+    cheapFrames_ = 0;
+    steadyFrames_ = 0;
+}
+
+void QualityController::apply(FaceTrackerAdapter& tracker) const {
+    if (!enabled()) return;
+    const Level& l = current();
+    tracker.setTrackingScale(l.trackingScale);
+    FaceTrackerAdapter::DetectionPolicy d = tracker.detectionPolicy();
+    d.fullFrameEvery = l.fullFrameEvery;
+    tracker.setDetectionPolicy(d);
+    FaceTrackerAdapter::InferencePolicy i = tracker.inferencePolicy();
+    i.every = l.inferEvery;
+    tracker.setInferencePolicy(i);
+}
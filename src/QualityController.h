@@ -0,0 +1,61 @@
+#pragma once
+#include "ofMain.h"
+#include <vector>
+#include "FaceTrackerAdapter.h"
+
+// Keeps the tracker within a per-frame latency budget by walking a ladder of
+// tracker configurations, cheapest last. Latency is averaged over a window
+// of frames; the controller steps down as soon as a window is over budget
+// and steps back up only after upDwellFrames of consecutive comfortably
+// cheap windows. A step up that is undone within one window doubles that
+// dwell (up to maxBackoff times), so a budget sitting between two levels
+// does not make it flip back and forth; every backoffDecayFrames spent at
+// one level halve it again. Only tracker knobs are touched: SmileFlow's
+// thresholds and timings are never part of a level.
+class QualityController {
+public:
+    struct Level {
+        float trackingScale = 1.f; // FaceTrackerAdapter::setTrackingScale
+        int   fullFrameEvery = 8;  // DetectionPolicy::fullFrameEvery
+        int   inferEvery = 1;      // InferencePolicy::every
+    };
+
+    struct Settings {
+        double budgetSeconds = 0.0; // <= 0: controller off
+        int    windowFrames = 30;
+        float  downAt = 1.f;        // step down when a window's mean exceeds budget * downAt
+        float  upAt = 0.6f;         // step up when it stays below budget * upAt
+        int    upDwellFrames = 150;
+        int    maxBackoff = 8;
+        int    backoffDecayFrames = 1800;
+        std::vector<Level> levels = defaultLevels();
+    };
+
+    static std::vector<Level> defaultLevels();
+
+    void setup(const Settings& s);
+    bool enabled() const { return s_.budgetSeconds > 0.0 && !s_.levels.empty(); }
+
+    // Called once per tracked frame with the time tracker.update() took.
+    // Returns true when the level changed; apply() it before the next frame.
+    bool update(double trackerSeconds);
+    void apply(FaceTrackerAdapter& tracker) const;
+
+    int level() const { return level_; }
+    const Level& current() const { return s_.levels[level_]; }
+    double windowMean() const { return lastMean_; }
+
+private:
+    void change(int to, const char* why);
+
+    Settings s_;
+    int      level_ = 0;
+    double   sum_ = 0.0;
+    int      count_ = 0;
+    double   lastMean_ = 0.0;
+    int      sinceChange_ = 0;   // frames at the current level
+    int      cheapFrames_ = 0;   // frames in the current run of cheap windows
+    int      steadyFrames_ = 0;  // frames at the current level since backoff_ last decayed
+    int      backoff_ = 1;
+    bool     lastWasUp_ = false;
+};
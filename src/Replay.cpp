@@ -0,0 +1,320 @@
+#include "Replay.h"
+#include "ofMain.h"
+#include "FlowInputs.h"
+#include "WorkStealingPool.h"
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+namespace replay {
+namespace {
+
+// "v" or "lo:hi:step" (hi included).
+bool parseRange(const std::string& s, std::vector<float>& out) {
+    auto parts = ofSplitString(s, ":");
+    out.clear();
+    if (parts.size() == 1) {
+        out.push_back(ofToFloat(parts[0]));
+        return true;
+    }
+    if (parts.size() != 3) return false;
+    float lo = ofToFloat(parts[0]), hi = ofToFloat(parts[1]), step = ofToFloat(parts[2]);
+    if (step <= 0.f || hi < lo) return false;
+    for (int i = 0; lo + i * step <= hi + 1e-3f * step; ++i) out.push_back(lo + i * step);
+    return true;
+}
+
+std::vector<std::string> collectStreams(const std::vector<std::string>& paths) {
+    std::vector<std::string> files;
+    for (const auto& p : paths) {
+        ofDirectory d(p);
+        if (!d.isDirectory()) {
+            files.push_back(p);
+            continue;
+        }
+        d.allowExt("lmk");
+        d.listDir();
+        d.sort();
+        for (size_t i = 0; i < d.size(); ++i) files.push_back(d.getPath(i));
+    }
+    return files;
+}
+
+struct Totals {
+    size_t sessions = 0;
+    size_t completed = 0;
+    size_t abnormal = 0;
+    double verdictSeconds = 0; // sum over completed sessions
+    // With --infer-every: the same sessions with skipped landmark frames.
+    size_t inferCompleted = 0;
+    size_t inferAbnormal = 0;
+    size_t inferAgree = 0;     // same completed/abnormal outcome as full rate
+    size_t inferLate = 0;      // stream ended at the full-rate verdict, before the skipping one
+    size_t frames = 0;
+    size_t predictedFrames = 0;
+};
+
+} // namespace
+
+Params defaults() {
+    SmileFlow flow;
+    Params p;
+    p.smileMin         = flow.evaluator().smile_min;
+    p.asymThreshold    = flow.evaluator().asym_threshold;
+    p.moveThreshNorm   = flow.stability().move_thresh_norm;
+    p.holdStillSeconds = flow.holdStillSeconds();
+    p.smileHoldSeconds = flow.smileHoldSeconds();
+    return p;
+}
+
+void apply(const Params& p, SmileFlow& flow) {
+    flow.evaluator().smile_min        = p.smileMin;
+    flow.evaluator().asym_threshold   = p.asymThreshold;
+    flow.stability().move_thresh_norm = p.moveThreshNorm;
+    flow.setHoldStillSeconds(p.holdStillSeconds);
+    flow.setSmileHoldSeconds(p.smileHoldSeconds);
+}
+
+void splitSessions(const MappedLandmarkFile& f, std::vector<std::pair<size_t, size_t>>& out) {
+    out.clear();
+    for (size_t i = 0; i < f.size(); ++i) {
+        if (!(f[i].flags & LandmarkRecord::SESSION_START)) continue;
+        if (!out.empty()) out.back().second = i;
+        out.emplace_back(i, f.size());
+    }
+}
+
+SessionResult runSession(const LandmarkRecord* begin, const LandmarkRecord* end, SmileFlow& flow) {
+    SessionResult r;
+    flow.reset();
+    if (begin == end) return r;
+    const double start = begin->time;
+    double last = start;
+    for (const LandmarkRecord* rec = begin; rec != end; ++rec) {
+        float dt = (float)std::max(0.0, rec->time - last);
+        last = rec->time;
+        flow.update(makeFlowInputs(*rec, dt));
+        r.frames++;
+        if (flow.stage() == SmileFlow::STAGE_EVALUATE) {
+            r.completed = true;
+            r.verdictSeconds = rec->time - start;
+            break;
+        }
+    }
+    r.abnormal  = flow.abnormal();
+    r.intensity = flow.smileIntensity();
+    r.asymmetry = flow.smileAsymmetry();
+    return r;
+}
+
+SessionResult runSessionPredicted(const LandmarkRecord* begin, const LandmarkRecord* end,
+                                  const guide::Oval& oval, const FaceTrackerAdapter::InferencePolicy& policy,
+                                  SmileFlow& flow, LandmarkPredictor& predictor, DerolledData& der) {
+    SessionResult r;
+    flow.reset();
+    predictor.reset();
+    if (begin == end) return r;
+    LandmarkFrame pts;
+    const double start = begin->time;
+    double last = start;
+    for (const LandmarkRecord* rec = begin; rec != end; ++rec) {
+        float dt = (float)std::max(0.0, rec->time - last);
+        last = rec->time;
+
+        const bool hasFace = (rec->flags & LandmarkRecord::HAS_FACE) != 0;
+        if (rec->flags & LandmarkRecord::UNMEASURED) {
+            flow.update(makeFlowInputs(false, false, der, dt, false));
+            r.frames++;
+            continue;
+        }
+        bool haveDer = false;
+        if (!hasFace) {
+            predictor.reset();
+        } else if (predictor.ready() && predictor.framesSinceMeasure() + 1 < policy.every &&
+                   predictor.normalizedSpeed() <= policy.maxSpeed) {
+            predictor.predict(pts);
+            haveDer = FaceTrackerAdapter::deroll(pts, oval, der);
+            der.predicted = true;
+            r.predictedFrames++;
+        } else {
+            predictor.measure(rec->raw);
+            haveDer = FaceTrackerAdapter::deroll(rec->raw, oval, der);
+        }
+        flow.update(makeFlowInputs(hasFace, haveDer, der, dt));
+        r.frames++;
+        if (flow.stage() == SmileFlow::STAGE_EVALUATE) {
+            r.completed = true;
+            r.verdictSeconds = rec->time - start;
+            break;
+        }
+    }
+    r.abnormal  = flow.abnormal();
+    r.intensity = flow.smileIntensity();
+    r.asymmetry = flow.smileAsymmetry();
+    return r;
+}
+
+int main(int argc, char* argv[]) {
+    const Params base = defaults();
+    std::vector<float> smileMin{ base.smileMin }, asym{ base.asymThreshold }, move{ base.moveThreshNorm };
+    std::vector<float> hold{ base.holdStillSeconds }, smileHold{ base.smileHoldSeconds };
+    std::string outPath = "sweep.csv";
+    std::string sessionsPath;
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    FaceTrackerAdapter::InferencePolicy inference;
+    std::vector<std::string> inputs;
+    bool ok = true;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if      (a == "--smile-min")  ok = parseRange(value(), smileMin) && ok;
+        else if (a == "--asym")       ok = parseRange(value(), asym) && ok;
+        else if (a == "--move")       ok = parseRange(value(), move) && ok;
+        else if (a == "--hold")       ok = parseRange(value(), hold) && ok;
+        else if (a == "--smile-hold") ok = parseRange(value(), smileHold) && ok;
+        else if (a == "--out")        outPath = value();
+        else if (a == "--sessions")   sessionsPath = value();
+        else if (a == "--jobs")       jobs = std::max(1, ofToInt(value()));
+        else if (a == "--infer-every") inference.every = std::max(1, ofToInt(value()));
+        else if (a == "--infer-speed") inference.maxSpeed = ofToFloat(value());
+        else inputs.push_back(a);
+    }
+
+    auto files = collectStreams(inputs);
+    if (!ok || files.empty()) {
+        ofLogError("replay") << "usage: --replay [--smile-min r] [--asym r] [--move r] [--hold r] [--smile-hold r] "
+                                "[--infer-every n] [--infer-speed f] [--jobs n] [--out sweep.csv] [--sessions s.csv] "
+                                "<file.lmk|dir>...  "
+                                "(r is a value or lo:hi:step)";
+        return 2;
+    }
+    jobs = std::min(jobs, files.size());
+
+    std::vector<Params> grid;
+    for (float a : smileMin) for (float b : asym) for (float c : move) for (float d : hold) for (float e : smileHold) {
+        grid.push_back({ a, b, c, d, e });
+    }
+
+    std::vector<std::vector<Totals>> totals(jobs, std::vector<Totals>(grid.size()));
+    std::vector<SmileFlow>   flows(jobs);
+    std::vector<LandmarkPredictor> predictors(jobs);
+    std::vector<DerolledData>      derolled(jobs);
+    const bool infer = inference.every > 1;
+    std::vector<std::string> sessionRows(sessionsPath.empty() ? 0 : files.size());
+    std::vector<size_t>      unreadable(jobs, 0);
+    auto wallStart = std::chrono::steady_clock::now();
+
+    // One task per file: each file is mapped once and replayed under every
+    // configuration while its pages are hot.
+    WorkStealingPool pool(jobs);
+    pool.run(files.size(), [&](size_t w, size_t task) {
+        MappedLandmarkFile f;
+        if (!f.open(files[task])) {
+            unreadable[w]++;
+            return;
+        }
+        std::vector<std::pair<size_t, size_t>> sessions;
+        splitSessions(f, sessions);
+        const guide::Oval oval = guide::geometryFor(f.header().frameWidth, f.header().frameHeight).oval;
+        for (size_t c = 0; c < grid.size(); ++c) {
+            apply(grid[c], flows[w]);
+            for (size_t s = 0; s < sessions.size(); ++s) {
+                const LandmarkRecord* first = f.begin() + sessions[s].first;
+                const LandmarkRecord* last  = f.begin() + sessions[s].second;
+                SessionResult r = runSession(first, last, flows[w]);
+                Totals& t = totals[w][c];
+                t.sessions++;
+                if (r.completed) {
+                    t.completed++;
+                    t.verdictSeconds += r.verdictSeconds;
+                }
+                if (r.abnormal) t.abnormal++;
+
+                SessionResult p;
+                if (infer) {
+                    p = runSessionPredicted(first, last, oval, inference, flows[w], predictors[w], derolled[w]);
+                    if (p.completed) t.inferCompleted++;
+                    if (p.abnormal)  t.inferAbnormal++;
+                    // Recordings stop at the verdict, so a verdict that skipping
+                    // only delays has no frames left to land on.
+                    if (r.completed && !p.completed && first + r.frames == last) t.inferLate++;
+                    else if (p.completed == r.completed && p.abnormal == r.abnormal) t.inferAgree++;
+                    t.frames += p.frames;
+                    t.predictedFrames += p.predictedFrames;
+                }
+                if (!sessionRows.empty()) {
+                    sessionRows[task] += '"' + files[task] + "\"," + ofToString(s) + "," + ofToString(c) + "," +
+                                         ofToString(r.frames) + "," + ofToString(r.completed) + "," +
+                                         ofToString(r.abnormal) + "," + ofToString(r.verdictSeconds) + "," +
+                                         ofToString(r.intensity) + "," + ofToString(r.asymmetry);
+                    if (infer) {
+                        sessionRows[task] += "," + ofToString(p.completed) + "," + ofToString(p.abnormal) + "," +
+                                             ofToString(p.predictedFrames);
+                    }
+                    sessionRows[task] += "\n";
+                }
+            }
+        }
+    });
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    std::ofstream out(ofToDataPath(outPath, true));
+    if (!out) {
+        ofLogError("replay") << "cannot write " << outPath;
+        return 1;
+    }
+    out << "config,smile_min,asym_threshold,move_thresh_norm,hold_s,smile_hold_s,"
+           "sessions,completed,abnormal,abnormal_rate,mean_verdict_s";
+    if (infer) out << ",infer_every,infer_completed,infer_abnormal,infer_agree,infer_late,infer_predicted_frac";
+    out << "\n";
+    size_t replayed = 0;
+    for (size_t c = 0; c < grid.size(); ++c) {
+        Totals t;
+        for (const auto& wt : totals) {
+            t.sessions       += wt[c].sessions;
+            t.completed      += wt[c].completed;
+            t.abnormal       += wt[c].abnormal;
+            t.verdictSeconds += wt[c].verdictSeconds;
+            t.inferCompleted += wt[c].inferCompleted;
+            t.inferAbnormal  += wt[c].inferAbnormal;
+            t.inferAgree     += wt[c].inferAgree;
+            t.inferLate      += wt[c].inferLate;
+            t.frames         += wt[c].frames;
+            t.predictedFrames += wt[c].predictedFrames;
+        }
+        replayed += t.sessions;
+        const Params& p = grid[c];
+        out << c << "," << p.smileMin << "," << p.asymThreshold << "," << p.moveThreshNorm << ","
+            << p.holdStillSeconds << "," << p.smileHoldSeconds << ","
+            << t.sessions << "," << t.completed << "," << t.abnormal << ","
+            << (t.completed ? double(t.abnormal) / t.completed : 0.0) << ","
+            << (t.completed ? t.verdictSeconds / t.completed : -1.0);
+        if (infer) {
+            out << "," << inference.every << "," << t.inferCompleted << "," << t.inferAbnormal << ","
+                << t.inferAgree << "," << t.inferLate << "," << (t.frames ? double(t.predictedFrames) / t.frames : 0.0);
+        }
+        out << "\n";
+    }
+
+    if (!sessionsPath.empty()) {
+        std::ofstream so(ofToDataPath(sessionsPath, true));
+        if (!so) {
+            ofLogError("replay") << "cannot write " << sessionsPath;
+            return 1;
+        }
+        so << "file,session,config,frames,completed,abnormal,verdict_s,intensity,asymmetry";
+        if (infer) so << ",infer_completed,infer_abnormal,infer_predicted";
+        so << "\n";
+        for (const auto& rows : sessionRows) so << rows;
+    }
+
+    size_t bad = 0;
+    for (size_t u : unreadable) bad += u;
+    ofLogNotice("replay") << files.size() << " files (" << bad << " unreadable), " << grid.size()
+                          << " configs, " << replayed << " session replays in " << ofToString(wall, 2) << " s ("
+                          << ofToString(replayed / std::max(1e-9, wall), 0) << " sessions/s)";
+    return bad > 0 ? 1 : 0;
+}
+
+} // namespace replay
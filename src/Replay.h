@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+#include "FaceTrackerAdapter.h"
+#include "LandmarkPredictor.h"
+#include "LandmarkRecording.h"
+#include "SmileFlow.h"
+
+// Re-runs SmileFlow over recorded landmark streams (.lmk) with no tracker,
+// model or video decode involved, so thresholds can be re-tuned against an
+// archive of real sessions.
+namespace replay {
+
+struct Params {
+    float smileMin = 0.f;
+    float asymThreshold = 0.f;
+    float moveThreshNorm = 0.f;
+    float holdStillSeconds = 0.f;
+    float smileHoldSeconds = 0.f;
+};
+// The values a default-constructed SmileFlow runs with.
+Params defaults();
+void apply(const Params& p, SmileFlow& flow);
+
+struct SessionResult {
+    size_t frames = 0;
+    bool   completed = false;   // reached STAGE_EVALUATE
+    bool   abnormal = false;
+    double verdictSeconds = -1; // session start to STAGE_EVALUATE
+    float  intensity = 0.f;
+    float  asymmetry = 0.f;
+    size_t predictedFrames = 0;
+};
+
+// [first, last) record ranges, one per session: each starts at a
+// SESSION_START record. Records before the first one are not part of a session.
+void splitSessions(const MappedLandmarkFile& f, std::vector<std::pair<size_t, size_t>>& out);
+// Replays one session on a freshly reset flow, stopping at the verdict.
+SessionResult runSession(const LandmarkRecord* begin, const LandmarkRecord* end, SmileFlow& flow);
+// Replays a full-rate session the way a tracker with the given inference
+// policy would have seen it: skipped frames get predicted landmarks, derolled
+// against oval. Only the speed gate applies; the image-change gate needs pixels.
+SessionResult runSessionPredicted(const LandmarkRecord* begin, const LandmarkRecord* end,
+                                  const guide::Oval& oval, const FaceTrackerAdapter::InferencePolicy& policy,
+                                  SmileFlow& flow, LandmarkPredictor& predictor, DerolledData& der);
+
+// Entry point for `--replay [options] <file.lmk|dir>...`. Returns the exit code.
+int main(int argc, char* argv[]);
+
+} // namespace replay
@@ -0,0 +1,200 @@
+#include "SessionRecorder.h"
+#include "SmileFlow.h"
+#include <cstdio>
+
+namespace {
+// How often an idle writer looks for new frames.
+const auto kWriterInterval = std::chrono::milliseconds(10);
+}
+
+SessionRecorder::~SessionRecorder() {
+    stop();
+}
+
+bool SessionRecorder::start(const Settings& s) {
+    stop();
+    if (s.format != "jpg" && s.format != "png" && s.format != "avi") {
+        ofLogError("SessionRecorder") << "unknown session format " << s.format;
+        return false;
+    }
+    const std::string dir = ofToDataPath(s.dir, true);
+    if (!ofDirectory::doesDirectoryExist(dir, false) && !ofDirectory::createDirectory(dir, false, true)) {
+        ofLogError("SessionRecorder") << "cannot create " << s.dir;
+        return false;
+    }
+    settings_ = s;
+    settings_.dir = dir;
+    capacity_ = std::max<size_t>(s.capacity, 2);
+    slots_.reset(new Slot[capacity_]);
+    pending_ = nullptr;
+    head_ = 0;
+    published_ = 0;
+    captured_ = droppedOldest_ = droppedBusy_ = written_ = sessions_ = 0;
+    stop_ = false;
+    writer_ = std::thread(&SessionRecorder::writerLoop, this);
+    return true;
+}
+
+void SessionRecorder::stop() {
+    if (!writer_.joinable()) return;
+    stop_ = true;
+    writer_.join();
+    if (droppedOldest_ > 0 || droppedBusy_ > 0) {
+        ofLogWarning("SessionRecorder") << droppedOldest_ << " frames dropped unwritten and " << droppedBusy_
+                                        << " not captured, the writer fell behind";
+    }
+}
+
+SessionRecorder::Frame& SessionRecorder::next() {
+    Slot& s = slots_[head_ % capacity_];
+    uint32_t state = s.state.load(std::memory_order_acquire);
+    // A full slot here is the oldest frame the writer has not got to yet.
+    if (state == FULL && s.state.compare_exchange_strong(state, EMPTY, std::memory_order_acq_rel)) {
+        droppedOldest_++;
+        state = EMPTY;
+    }
+    pending_ = state == EMPTY ? &s : nullptr;
+    return pending_ ? pending_->frame : spare_;
+}
+
+void SessionRecorder::publish() {
+    if (!pending_) {
+        droppedBusy_++;
+        return;
+    }
+    pending_->seq = head_++;
+    pending_->state.store(FULL, std::memory_order_release);
+    pending_ = nullptr;
+    published_.store(head_, std::memory_order_release);
+    captured_++;
+}
+
+SessionRecorder::Stats SessionRecorder::stats() const {
+    Stats s;
+    s.captured      = captured_.load(std::memory_order_relaxed);
+    s.droppedOldest = droppedOldest_.load(std::memory_order_relaxed);
+    s.droppedBusy   = droppedBusy_.load(std::memory_order_relaxed);
+    s.written       = written_.load(std::memory_order_relaxed);
+    s.sessions      = sessions_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void SessionRecorder::writerLoop() {
+    uint64_t tail = 0; // seq of the next frame to write
+    Frame work;
+    while (true) {
+        Slot& s = slots_[tail % capacity_];
+        uint32_t expected = FULL;
+        if (!s.state.compare_exchange_strong(expected, TAKING, std::memory_order_acq_rel)) {
+            if (stop_ && tail >= published_.load(std::memory_order_acquire)) break;
+            std::this_thread::sleep_for(kWriterInterval);
+            continue;
+        }
+        if (s.seq != tail) {
+            // The producer lapped the writer and took frames back; the oldest
+            // one left is the frame after this slot's.
+            uint64_t seq = s.seq;
+            s.state.store(FULL, std::memory_order_release);
+            tail = seq - capacity_ + 1;
+            continue;
+        }
+        // Swapping keeps both buffers allocated; the slot is free again at once.
+        std::swap(work, s.frame);
+        s.state.store(EMPTY, std::memory_order_release);
+        tail++;
+        write(work);
+    }
+    closeSession();
+}
+
+void SessionRecorder::write(Frame& f) {
+    if (!sessionOpen_ || f.session != session_) {
+        closeSession();
+        if (!openSession(f)) return;
+    }
+    const uint64_t index = sessionFrames_++;
+    const LandmarkRecord& r = f.record;
+    std::fprintf(csv_, "%llu,%.4f,%s,%.3f,%.4f,%.4f,%d,%d,%d,%d,%d\n", (unsigned long long)index, r.time,
+                 SmileFlow::stageName((SmileFlow::Stage)f.stage), f.progress, f.intensity, f.asymmetry,
+                 (r.flags & LandmarkRecord::HAS_FACE) != 0, (r.flags & LandmarkRecord::INSIDE_GUIDE) != 0,
+                 (r.flags & LandmarkRecord::PREDICTED) != 0, (r.flags & LandmarkRecord::UNMEASURED) == 0,
+                 f.abnormal);
+    std::fwrite(&r, sizeof(LandmarkRecord), 1, lmk_);
+
+    if (settings_.overlay) drawOverlay(f);
+    if (settings_.format == "avi") {
+        cv::cvtColor(ofxCv::toCv(f.pixels), bgr_, cv::COLOR_RGB2BGR);
+        video_.write(bgr_);
+    } else {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06llu.", (unsigned long long)index);
+        ofSaveImage(f.pixels, sessionDir_ + "/" + name + settings_.format, OF_IMAGE_QUALITY_HIGH);
+    }
+    written_++;
+    if (f.last) closeSession();
+}
+
+bool SessionRecorder::openSession(const Frame& f) {
+    sessionDir_ = settings_.dir + "/" + ofGetTimestampString("%Y%m%d-%H%M%S") + "-" + ofToString(f.session);
+    if (!ofDirectory::createDirectory(sessionDir_, false, true)) {
+        ofLogError("SessionRecorder") << "cannot create " << sessionDir_;
+        return false;
+    }
+    csv_ = std::fopen((sessionDir_ + "/frames.csv").c_str(), "w");
+    lmk_ = std::fopen((sessionDir_ + "/landmarks.lmk").c_str(), "wb");
+    if (!csv_ || !lmk_) {
+        ofLogError("SessionRecorder") << "cannot write to " << sessionDir_;
+        if (csv_) std::fclose(csv_);
+        if (lmk_) std::fclose(lmk_);
+        csv_ = lmk_ = nullptr;
+        return false;
+    }
+    std::fputs("frame,time,stage,progress,intensity,asymmetry,has_face,inside_guide,predicted,measured,abnormal\n", csv_);
+    LandmarkFileHeader h;
+    h.recordSize  = sizeof(LandmarkRecord);
+    h.frameWidth  = (int32_t)f.pixels.getWidth();
+    h.frameHeight = (int32_t)f.pixels.getHeight();
+    std::fwrite(&h, sizeof(h), 1, lmk_);
+    if (settings_.format == "avi") {
+        video_.open(sessionDir_ + "/session.avi", cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), settings_.videoFps,
+                    cv::Size(h.frameWidth, h.frameHeight));
+        if (!video_.isOpened()) ofLogError("SessionRecorder") << "cannot open a video writer in " << sessionDir_;
+    }
+    session_ = f.session;
+    sessionOpen_ = true;
+    sessionFrames_ = 0;
+    sessions_++;
+    return true;
+}
+
+void SessionRecorder::closeSession() {
+    if (!sessionOpen_) return;
+    std::fclose(csv_);
+    std::fclose(lmk_);
+    csv_ = lmk_ = nullptr;
+    if (video_.isOpened()) video_.release();
+    sessionOpen_ = false;
+    ofLogNotice("SessionRecorder") << sessionDir_ << ": " << sessionFrames_ << " frames";
+}
+
+// Camera orientation, i.e. not mirrored like the live view.
+void SessionRecorder::drawOverlay(Frame& f) {
+    cv::Mat img = ofxCv::toCv(f.pixels);
+    const LandmarkRecord& r = f.record;
+    const cv::Scalar white(255, 255, 255);
+    const bool inside = (r.flags & LandmarkRecord::INSIDE_GUIDE) != 0;
+    cv::ellipse(img, cv::Point(std::lround(f.oval.center.x), std::lround(f.oval.center.y)),
+                cv::Size(std::lround(f.oval.a), std::lround(f.oval.b)), 0, 0, 360,
+                inside ? cv::Scalar(40, 220, 120) : cv::Scalar(230, 70, 70), 2);
+    if (r.flags & LandmarkRecord::HAS_FACE) {
+        for (const auto& p : r.raw) cv::circle(img, cv::Point(std::lround(p.x), std::lround(p.y)), 2, white, -1);
+    }
+    char text[128];
+    std::snprintf(text, sizeof(text), "%s  progress %.0f%%  smile %.3f  asym %.3f",
+                  SmileFlow::stageName((SmileFlow::Stage)f.stage), f.progress * 100.f, f.intensity, f.asymmetry);
+    cv::putText(img, text, cv::Point(16, 32), cv::FONT_HERSHEY_SIMPLEX, 0.8, white, 2);
+    if (f.stage == SmileFlow::STAGE_EVALUATE) {
+        cv::putText(img, f.abnormal ? "ABNORMALITY DETECTED" : "NORMAL", cv::Point(16, 72), cv::FONT_HERSHEY_SIMPLEX,
+                    1.2, f.abnormal ? cv::Scalar(230, 60, 60) : cv::Scalar(60, 200, 120), 3);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxCv.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "GuideOval.h"
+#include "LandmarkRecording.h"
+
+// Keeps an audit copy of each session: the camera frames with the oval,
+// landmarks and stage drawn on, a per-frame CSV of what the flow saw, and
+// the landmark stream as a .lmk that --replay accepts. Each session gets a
+// directory of its own under Settings::dir.
+//
+// One producer thread fills slots of a fixed ring and never waits; a
+// background thread swaps frames out and encodes them. When the writer falls
+// a whole ring behind, the producer takes back the oldest unwritten frame,
+// so the newest frames are the ones kept. The only frame the producer cannot
+// take is one the writer is swapping out at that instant; then the incoming
+// frame is dropped instead. Both are counted.
+class SessionRecorder {
+public:
+    struct Settings {
+        std::string dir;            // sessions are written below this directory
+        std::string format = "jpg"; // jpg, png (image sequence) or avi (MJPG video)
+        size_t capacity = 60;       // frames in flight, about 2 s of camera
+        bool   overlay = true;      // draw oval, landmarks and stage on the frames
+        double videoFps = 30.0;
+    };
+
+    // One captured frame and what the flow made of it.
+    struct Frame {
+        uint64_t session = 0;
+        bool     last = false;      // the writer closes the session after this one
+        ofPixels pixels;
+        LandmarkRecord record;
+        guide::Oval oval;
+        int      stage = 0;         // SmileFlow::Stage
+        float    progress = 0.f, intensity = 0.f, asymmetry = 0.f;
+        bool     abnormal = false;
+    };
+
+    struct Stats {
+        uint64_t captured = 0;      // frames handed to the writer
+        uint64_t droppedOldest = 0; // taken back unwritten because the ring was full
+        uint64_t droppedBusy = 0;   // not captured, the writer held the slot
+        uint64_t written = 0;
+        uint64_t sessions = 0;
+    };
+
+    ~SessionRecorder();
+
+    bool start(const Settings& s);
+    // Writes out what is queued, then stops the writer.
+    void stop();
+    bool running() const { return writer_.joinable(); }
+
+    // Producer side. next() returns the slot to fill and publish() hands it
+    // to the writer.
+    Frame& next();
+    void publish();
+
+    Stats stats() const;
+
+private:
+    enum SlotState : uint32_t { EMPTY = 0, FULL, TAKING };
+    struct Slot {
+        std::atomic<uint32_t> state{EMPTY};
+        uint64_t seq = 0;           // publish order, valid while FULL
+        Frame    frame;
+    };
+
+    void writerLoop();
+    void write(Frame& f);
+    bool openSession(const Frame& f);
+    void closeSession();
+    void drawOverlay(Frame& f);
+
+    Settings settings_;
+    std::unique_ptr<Slot[]> slots_;
+    size_t   capacity_ = 0;
+    Frame    spare_;                // target of next() when no slot could be had
+    Slot*    pending_ = nullptr;    // producer
+    uint64_t head_ = 0;             // producer: seq of the next publish
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> captured_{0}, droppedOldest_{0}, droppedBusy_{0}, written_{0}, sessions_{0};
+    std::atomic<bool> stop_{false};
+    std::thread writer_;
+
+    // Writer thread.
+    uint64_t        session_ = 0;
+    bool            sessionOpen_ = false;
+    std::string     sessionDir_;
+    FILE*           csv_ = nullptr;
+    FILE*           lmk_ = nullptr;
+    cv::VideoWriter video_;
+    cv::Mat         bgr_;
+    uint64_t        sessionFrames_ = 0;
+};
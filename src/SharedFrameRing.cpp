@@ -0,0 +1,166 @@
+#include "SharedFrameRing.h"
+#include "ofMain.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const size_t kPage = 4096;
+
+size_t alignUp(size_t v, size_t a) {
+    return (v + a - 1) / a * a;
+}
+} // namespace
+
+SharedFrameRing::~SharedFrameRing() {
+    close();
+}
+
+int64_t SharedFrameRing::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool SharedFrameRing::create(const std::string& name, int width, int height, int channels, int slots) {
+    close();
+    if (width <= 0 || height <= 0 || channels <= 0 || slots < 3) {
+        ofLogError("SharedFrameRing") << "bad ring geometry for " << name;
+        return false;
+    }
+    const size_t slotBytes = (size_t)width * height * channels;
+    const size_t dataOffset = alignUp(sizeof(IngestHeader) + slots * sizeof(IngestSlot), kPage);
+    const size_t bytes = dataOffset + alignUp(slotBytes, kPage) * slots;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        ofLogError("SharedFrameRing") << "cannot create " << name << ": " << std::strerror(errno);
+        return false;
+    }
+    if (ftruncate(fd, (off_t)bytes) != 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        ofLogError("SharedFrameRing") << "cannot size " << name;
+        return false;
+    }
+    void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+    data_ = data;
+    bytes_ = bytes;
+    name_ = name;
+    owner_ = true;
+
+    header_ = new (data_) IngestHeader();
+    header_->slots = slots;
+    header_->width = width;
+    header_->height = height;
+    header_->channels = channels;
+    header_->slotBytes = alignUp(slotBytes, kPage);
+    header_->dataOffset = dataOffset;
+    slots_ = reinterpret_cast<IngestSlot*>(static_cast<uint8_t*>(data_) + sizeof(IngestHeader));
+    for (int i = 0; i < slots; ++i) new (&slots_[i]) IngestSlot();
+    pixels_ = static_cast<uint8_t*>(data_) + dataOffset;
+    return true;
+}
+
+bool SharedFrameRing::open(const std::string& name) {
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        ofLogError("SharedFrameRing") << "cannot open " << name << ": " << std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IngestHeader)) {
+        ::close(fd);
+        return false;
+    }
+    // Read-write: the slot states are shared.
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return false;
+    data_ = data;
+    bytes_ = (size_t)st.st_size;
+    name_ = name;
+    owner_ = false;
+
+    header_ = static_cast<IngestHeader*>(data_);
+    const IngestHeader& h = *header_;
+    if (std::memcmp(h.magic, "SFIR", 4) != 0 || h.version != 1 || h.slots < 3 ||
+        h.dataOffset < sizeof(IngestHeader) + h.slots * sizeof(IngestSlot) ||
+        h.slotBytes < (uint64_t)h.width * h.height * h.channels ||
+        h.dataOffset + h.slotBytes * h.slots > bytes_) {
+        ofLogError("SharedFrameRing") << name << ": not a version 1 frame ring";
+        close();
+        return false;
+    }
+    slots_ = reinterpret_cast<IngestSlot*>(static_cast<uint8_t*>(data_) + sizeof(IngestHeader));
+    pixels_ = static_cast<uint8_t*>(data_) + h.dataOffset;
+    return true;
+}
+
+void SharedFrameRing::close() {
+    if (data_) munmap(data_, bytes_);
+    if (owner_) shm_unlink(name_.c_str());
+    data_ = nullptr;
+    bytes_ = 0;
+    owner_ = false;
+    header_ = nullptr;
+    slots_ = nullptr;
+    pixels_ = nullptr;
+}
+
+int SharedFrameRing::beginWrite() {
+    const int n = (int)header_->slots;
+    // A free slot, else the oldest frame nobody has read.
+    for (int pass = 0; pass < 2; ++pass) {
+        int best = -1;
+        for (int i = 0; i < n; ++i) {
+            uint32_t s = slots_[i].state.load(std::memory_order_acquire);
+            if (pass == 0 && s == IngestSlot::FREE) { best = i; break; }
+            if (pass == 1 && s == IngestSlot::READY && (best < 0 || slots_[i].frame < slots_[best].frame)) best = i;
+        }
+        if (best < 0) continue;
+        uint32_t expected = pass == 0 ? IngestSlot::FREE : IngestSlot::READY;
+        if (slots_[best].state.compare_exchange_strong(expected, IngestSlot::WRITING, std::memory_order_acq_rel)) {
+            return best;
+        }
+    }
+    return -1;
+}
+
+void SharedFrameRing::endWrite(int slot, uint64_t frame, int64_t captureNs) {
+    slots_[slot].frame = frame;
+    slots_[slot].captureNs = captureNs;
+    slots_[slot].state.store(IngestSlot::READY, std::memory_order_release);
+    header_->published.fetch_add(1, std::memory_order_release);
+}
+
+int SharedFrameRing::acquireNewest(uint64_t from) {
+    const int n = (int)header_->slots;
+    while (true) {
+        int best = -1;
+        for (int i = 0; i < n; ++i) {
+            if (slots_[i].state.load(std::memory_order_acquire) != IngestSlot::READY) continue;
+            if (slots_[i].frame < from) continue;
+            if (best < 0 || slots_[i].frame > slots_[best].frame) best = i;
+        }
+        if (best < 0) return -1;
+        uint32_t expected = IngestSlot::READY;
+        if (slots_[best].state.compare_exchange_strong(expected, IngestSlot::READING, std::memory_order_acq_rel)) {
+            return best;
+        }
+        // The producer took it back for a newer frame; look again.
+    }
+}
+
+void SharedFrameRing::release(int slot) {
+    slots_[slot].state.store(IngestSlot::FREE, std::memory_order_release);
+}
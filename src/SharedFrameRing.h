@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// A ring of camera frames in POSIX shared memory, written by one process and
+// read in place by another. The segment starts with a header, then one
+// 64-byte control block per slot, then the slots' pixels, page aligned:
+//
+//   IngestHeader | IngestSlot[slots] | pixels[slots][width * height * channels]
+//
+// Slot ownership is a lock-free state word in the shared mapping. The
+// producer fills any slot the reader does not hold, preferring free ones and
+// then the oldest unread; the reader takes the newest ready frame, so a slow
+// reader skips frames instead of queueing them. With three or more slots the
+// producer always finds one.
+struct IngestHeader {
+    char     magic[4] = { 'S', 'F', 'I', 'R' };
+    uint32_t version = 1;
+    uint32_t slots = 0;
+    uint32_t width = 0, height = 0, channels = 0;
+    uint64_t slotBytes = 0;  // width * height * channels
+    uint64_t dataOffset = 0; // from the start of the segment to slot 0's pixels
+    std::atomic<uint64_t> published{0};
+    uint8_t  reserved[16] = {};
+};
+
+struct IngestSlot {
+    enum State : uint32_t { FREE = 0, WRITING, READY, READING };
+    std::atomic<uint32_t> state{FREE};
+    uint32_t reserved0 = 0;
+    uint64_t frame = 0;     // producer's frame index
+    int64_t  captureNs = 0; // steady clock at capture, see SharedFrameRing::nowNs
+    uint8_t  reserved[40] = {};
+};
+
+static_assert(sizeof(IngestHeader) == 64, "ingest header layout changed");
+static_assert(sizeof(IngestSlot) == 64, "ingest slot layout changed");
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "slot states are shared between processes");
+
+class SharedFrameRing {
+public:
+    SharedFrameRing() = default;
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+    ~SharedFrameRing();
+
+    // Producer: creates the segment; it is unlinked again on close().
+    bool create(const std::string& name, int width, int height, int channels, int slots = 4);
+    // Reader: maps a segment another process created.
+    bool open(const std::string& name);
+    void close();
+    bool isOpen() const { return data_ != nullptr; }
+
+    const IngestHeader& header() const { return *header_; }
+    int width() const    { return (int)header_->width; }
+    int height() const   { return (int)header_->height; }
+    int channels() const { return (int)header_->channels; }
+    const IngestSlot& slot(int i) const { return slots_[i]; }
+    uint8_t* pixels(int i) const { return pixels_ + (size_t)i * header_->slotBytes; }
+
+    // Producer. beginWrite() returns a slot to fill (-1 if none is free),
+    // endWrite() makes it readable.
+    int  beginWrite();
+    void endWrite(int slot, uint64_t frame, int64_t captureNs);
+
+    // Reader. Takes the newest ready frame numbered `from` or later (-1 if
+    // none); its pixels stay put until release().
+    int  acquireNewest(uint64_t from);
+    void release(int slot);
+
+    // The clock captureNs is taken with; the same in every local process.
+    static int64_t nowNs();
+
+private:
+    void*         data_ = nullptr;
+    size_t        bytes_ = 0;
+    std::string   name_;
+    bool          owner_ = false;
+    IngestHeader* header_ = nullptr;
+    IngestSlot*   slots_ = nullptr;
+    uint8_t*      pixels_ = nullptr;
+};
@@ -15,13 +15,14 @@ void SmileEvaluator::calibrate(const glm::vec2& left_corner, const glm::vec2& ri
     base_iod_ = iod;
     calibrated_ = true;
 }
-void SmileEvaluator::updateMetrics(const std::vector<glm::vec2>& ptsDerolled, float iod) {
-    if (!calibrated_ || ptsDerolled.size() <= LM_RIGHT_MOUTH_CORNER) {
+void SmileEvaluator::updateMetrics(const LandmarkFrame& ptsDerolled, float iod) {
+    updateMetrics(ptsDerolled[LM_LEFT_MOUTH_CORNER], ptsDerolled[LM_RIGHT_MOUTH_CORNER], iod);
+}
+void SmileEvaluator::updateMetrics(const glm::vec2& L, const glm::vec2& R, float iod) {
+    if (!calibrated_) {
         decayToZero(0.2f);
         return;
     }
-    glm::vec2 L = ptsDerolled[LM_LEFT_MOUTH_CORNER];
-    glm::vec2 R = ptsDerolled[LM_RIGHT_MOUTH_CORNER];
     float leftRaise  = (base_left_.y  - L.y) / std::max(1.f, iod);
     float rightRaise = (base_right_.y - R.y) / std::max(1.f, iod);
     float mean_abs = 0.5f * (std::abs(leftRaise) + std::abs(rightRaise));
@@ -1,7 +1,6 @@
 #pragma once
 #include "ofMain.h"
-#include <vector>
-#include "Landmarks68.h"
+#include "LandmarkFrame.h"
 
 class SmileEvaluator {
 public:
@@ -11,7 +10,8 @@ public:
 
     void reset();
     void calibrate(const glm::vec2& left_corner, const glm::vec2& right_corner, float iod);
-    void updateMetrics(const std::vector<glm::vec2>& ptsDerolled, float iod);
+    void updateMetrics(const LandmarkFrame& ptsDerolled, float iod);
+    void updateMetrics(const glm::vec2& left_corner, const glm::vec2& right_corner, float iod);
     void decayToZero(float alpha);
 
     bool  isCalibrated() const;
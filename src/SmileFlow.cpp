@@ -1,5 +1,18 @@
 #include "SmileFlow.h"
 #include "ofMain.h"
+#include <cstdio>
+#include <limits>
+
+const char* SmileFlow::stageName(Stage s) {
+    switch (s) {
+        case STAGE_HOME:         return "home";
+        case STAGE_ALIGN:        return "align";
+        case STAGE_HOLD_STILL:   return "hold_still";
+        case STAGE_PROMPT_SMILE: return "prompt_smile";
+        case STAGE_EVALUATE:     return "evaluate";
+        default:                 return "unknown";
+    }
+}
 
 void SmileFlow::reset() {
     stage_ = STAGE_ALIGN;
@@ -7,9 +20,44 @@ void SmileFlow::reset() {
     smile_.reset();
     smileHoldTime_ = 0.f;
     abnormal_ = false;
+    extractor_.reset();
+    features_.fill(0.f);
+    started_ = false;
+}
+
+SmileFlow::Metrics::Metrics(metrics::Registry& r, const metrics::Labels& labels)
+    : started(&r.counter("stroke_flow_sessions_started_total", "Screenings started.", labels)),
+      completed(&r.counter("stroke_flow_sessions_completed_total", "Screenings that reached a verdict.", labels)),
+      abnormal(&r.counter("stroke_flow_sessions_abnormal_total", "Screenings flagged abnormal.", labels)) {
+    for (int s = 0; s < kNumStages; ++s) {
+        metrics::Labels l = labels;
+        l.emplace_back("stage", stageName(Stage(s)));
+        stageMicros[s] = &r.counter("stroke_flow_stage_seconds_total", "Time spent in each stage.", l, 1e-6);
+    }
+}
+
+void SmileFlow::setMetrics(metrics::Registry* r, const metrics::Labels& labels) {
+    metrics_ = r ? std::make_shared<const Metrics>(*r, labels) : nullptr;
+}
+
+features::Vector SmileFlow::offThresholds() {
+    features::Vector v;
+    v.fill(std::numeric_limits<float>::infinity());
+    return v;
+}
+
+bool SmileFlow::aboveFeatureThreshold() const {
+    for (int i = 0; i < features::kNumFeatures; ++i) {
+        if (features_[i] > featureThresholds_[i]) return true;
+    }
+    return false;
 }
 
 void SmileFlow::update(const Inputs& in) {
+    if (metrics_ && in.dt > 0.f) metrics_->stageMicros[stage_]->add((uint64_t)std::lround(in.dt * 1e6f));
+    // Neither progress nor the smile baseline may come from a frame nobody
+    // could measure, and it is no reason to start over either.
+    if (!in.measured) return;
     if (!in.hasFace) {
         smile_.decayToZero(0.08f);
         if (stage_ != STAGE_EVALUATE) stage_ = STAGE_ALIGN;
@@ -19,7 +67,12 @@ void SmileFlow::update(const Inputs& in) {
         case STAGE_ALIGN: {
             stability_.reset();
             smileHoldTime_ = 0.f;
-            if (in.insideGuide) stage_ = STAGE_HOLD_STILL;
+            if (!in.insideGuide) break;
+            stage_ = STAGE_HOLD_STILL;
+            // A screening starts with someone in the oval, not with every
+            // reset: those also come with nobody there to screen.
+            if (!started_ && metrics_) metrics_->started->add();
+            started_ = true;
             break;
         }
         case STAGE_HOLD_STILL: {
@@ -27,23 +80,32 @@ void SmileFlow::update(const Inputs& in) {
             if (!in.insideGuide) { stage_ = STAGE_ALIGN; break; }
             if (stability_.stableTime() >= holdStillSeconds_) {
                 if (in.haveMouth) smile_.calibrate(in.mouthLeft, in.mouthRight, in.iod);
+                if (in.derolled) extractor_.calibrate(*in.derolled);
                 stage_ = STAGE_PROMPT_SMILE;
             }
             break;
         }
         case STAGE_PROMPT_SMILE: {
             if (!in.insideGuide) { stage_ = STAGE_ALIGN; break; }
-            if (!in.derolledPoints.empty()) {
-                smile_.updateMetrics(in.derolledPoints, in.iod);
+            if (in.derolled) {
+                smile_.updateMetrics(*in.derolled, in.iod);
+                extractor_.extract(*in.derolled, in.iod, frameFeatures_);
+                const float a = smile_.smoothing_alpha;
+                for (int i = 0; i < features::kNumFeatures; ++i) {
+                    features_[i] = (1.f - a) * features_[i] + a * frameFeatures_[i];
+                }
             } else if (in.haveMouth) {
-                std::vector<glm::vec2> two = { in.mouthLeft, in.mouthRight };
-                smile_.updateMetrics(two, in.iod);
+                smile_.updateMetrics(in.mouthLeft, in.mouthRight, in.iod);
             }
             if (smile_.intensity() >= smile_.smile_min) smileHoldTime_ += in.dt;
             else smileHoldTime_ = 0.f;
             if (smileHoldTime_ >= smileHoldSeconds_) {
-                abnormal_ = smile_.aboveAsymmetryThreshold();
+                abnormal_ = smile_.aboveAsymmetryThreshold() || aboveFeatureThreshold();
                 stage_ = STAGE_EVALUATE;
+                if (metrics_) {
+                    metrics_->completed->add();
+                    if (abnormal_) metrics_->abnormal->add();
+                }
             }
             break;
         }
@@ -59,28 +121,46 @@ float SmileFlow::stabilityProgress() const {
     return ofClamp(p, 0.f, 1.f);
 }
 
-std::vector<std::string> SmileFlow::uiLines() const {
-    std::vector<std::string> lines;
+const SmileFlow::UiText& SmileFlow::uiLines() const {
+    UiKey key;
+    key.stage = stage_;
+    if (stage_ == STAGE_HOLD_STILL) {
+        key.progressPct = (int)std::round(stabilityProgress() * 100.f);
+    } else if (stage_ == STAGE_PROMPT_SMILE) {
+        key.intensityMilli = (int)std::round(smile_.intensity() * 1000.f);
+        key.asymmetryMilli = (int)std::round(smile_.asymmetry() * 1000.f);
+    }
+    if (uiValid_ && key == uiKey_) return ui_;
+    uiKey_ = key;
+    uiValid_ = true;
+
+    // assign() reuses each line's buffer, so steady-state updates do not allocate.
+    char buf[96];
+    ui_.count = 0;
+    auto add = [&](const char* text) { ui_.lines[ui_.count++].assign(text); };
     switch (stage_) {
         case STAGE_ALIGN:
-            lines.push_back("Align your head inside the oval.");
-            lines.push_back("Keep your head roughly upright.");
+            add("Align your head inside the oval.");
+            add("Keep your head roughly upright.");
             break;
         case STAGE_HOLD_STILL:
-            lines.push_back("Hold still...");
-            lines.push_back("Capturing neutral baseline.");
-            lines.push_back("Progress: " + ofToString(stabilityProgress() * 100.f, 0) + "%");
+            add("Hold still...");
+            add("Capturing neutral baseline.");
+            std::snprintf(buf, sizeof(buf), "Progress: %d%%", key.progressPct);
+            add(buf);
             break;
         case STAGE_PROMPT_SMILE:
-            lines.push_back("Show your teeth (smile)!");
-            lines.push_back("Hold for a moment...");
-            lines.push_back("Smile intensity: " + ofToString(smile_.intensity(), 3) + "  |  Asym: " + ofToString(smile_.asymmetry(), 3));
+            add("Show your teeth (smile)!");
+            add("Hold for a moment...");
+            std::snprintf(buf, sizeof(buf), "Smile intensity: %.3f  |  Asym: %.3f",
+                          key.intensityMilli / 1000.f, key.asymmetryMilli / 1000.f);
+            add(buf);
             break;
         case STAGE_EVALUATE:
-            lines.push_back("Result:");
-            lines.push_back("Press [R] to restart");
+            add("Result:");
+            add("Press [R] to restart");
             break;
         default: break;
     }
-    return lines;
+    return ui_;
 }
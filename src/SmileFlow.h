@@ -1,17 +1,25 @@
 #pragma once
 #include "ofMain.h"
-#include <vector>
+#include <array>
+#include <memory>
 #include <string>
+#include "AsymmetryFeatures.h"
+#include "LandmarkFrame.h"
+#include "Metrics.h"
 #include "StabilityMonitor.h"
 #include "SmileEvaluator.h"
 
 class SmileFlow {
 public:
     enum Stage { STAGE_HOME = 0, STAGE_ALIGN, STAGE_HOLD_STILL, STAGE_PROMPT_SMILE, STAGE_EVALUATE };
+    static constexpr int kNumStages = STAGE_EVALUATE + 1;
+    static const char* stageName(Stage s);
 
     void reset();
     void setHoldStillSeconds(float s) { holdStillSeconds_ = s; }
     void setSmileHoldSeconds(float s) { smileHoldSeconds_ = s; }
+    float holdStillSeconds() const { return holdStillSeconds_; }
+    float smileHoldSeconds() const { return smileHoldSeconds_; }
 
     struct Inputs {
         bool   hasFace = false;
@@ -22,7 +30,22 @@ public:
         glm::vec2 mouthLeft{0,0};
         glm::vec2 mouthRight{0,0};
         bool   haveMouth = false;
-        std::vector<glm::vec2> derolledPoints;
+        const LandmarkFrame* derolled = nullptr; // borrowed for the duration of update()
+        // False for a frame too poor to track (see FrameGate); the flow
+        // treats it as if it never arrived.
+        bool   measured = true;
+    };
+
+    // Instruction text for the current stage. Lines keep their storage between
+    // frames and are only rewritten when the stage or a displayed value changes.
+    struct UiText {
+        static constexpr int kMaxLines = 3;
+        std::array<std::string, kMaxLines> lines;
+        int count = 0;
+        size_t size() const { return (size_t)count; }
+        const std::string* begin() const { return lines.data(); }
+        const std::string* end()   const { return lines.data() + count; }
+        const std::string& operator[](size_t i) const { return lines[i]; }
     };
 
     void update(const Inputs& in);
@@ -32,7 +55,31 @@ public:
     float stabilityProgress() const;
     float smileIntensity() const { return smile_.intensity(); }
     float smileAsymmetry() const { return smile_.asymmetry(); }
-    std::vector<std::string> uiLines() const;
+    const UiText& uiLines() const;
+    // Regional features while smiling, smoothed like the smile metrics;
+    // baseline taken with the smile's at the end of hold-still.
+    const features::Vector& features() const { return features_; }
+    // The verdict is also abnormal when a feature exceeds its threshold.
+    // All are off (infinite) by default.
+    void setFeatureThreshold(int index, float t) { featureThresholds_[index] = t; }
+    float featureThreshold(int index) const { return featureThresholds_[index]; }
+
+    // Time in each stage and screenings started, completed and flagged, for
+    // monitoring, under the given labels.
+    struct Metrics {
+        Metrics(metrics::Registry& r, const metrics::Labels& labels);
+        metrics::Counter* stageMicros[kNumStages];
+        metrics::Counter* started;   // first move past align after a reset()
+        metrics::Counter* completed; // verdicts reached
+        metrics::Counter* abnormal;  // ... of which abnormal
+    };
+    // Reports to r from now on, copies included; nullptr stops reporting.
+    void setMetrics(metrics::Registry* r, const metrics::Labels& labels = {});
+
+    // Thresholds live on the components (smile_min, asym_threshold,
+    // move_thresh_norm); reset() keeps them.
+    SmileEvaluator&   evaluator() { return smile_; }
+    StabilityMonitor& stability() { return stability_; }
 
 private:
     Stage stage_ = STAGE_HOME;
@@ -42,4 +89,28 @@ private:
     float  smileHoldSeconds_ = 0.6f;
     float  smileHoldTime_ = 0.f;
     bool   abnormal_ = false;
+    bool   started_ = false;  // counted in Metrics::started since the last reset()
+    bool   aboveFeatureThreshold() const;
+
+    features::AsymmetryExtractor extractor_;
+    features::Vector features_{};
+    features::Vector frameFeatures_{};
+    features::Vector featureThresholds_ = offThresholds();
+    static features::Vector offThresholds();
+
+    std::shared_ptr<const Metrics> metrics_;
+
+    struct UiKey {
+        Stage stage = STAGE_HOME;
+        int   progressPct = -1;
+        int   intensityMilli = -1;
+        int   asymmetryMilli = -1;
+        bool operator==(const UiKey& o) const {
+            return stage == o.stage && progressPct == o.progressPct &&
+                   intensityMilli == o.intensityMilli && asymmetryMilli == o.asymmetryMilli;
+        }
+    };
+    mutable UiText ui_;
+    mutable UiKey  uiKey_;
+    mutable bool   uiValid_ = false;
 };
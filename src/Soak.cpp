@@ -0,0 +1,323 @@
+#include "Soak.h"
+#include "ofMain.h"
+#include "FaceTrackerAdapter.h"
+#include "FlowInputs.h"
+#include "SmileFlow.h"
+#include "Stats.h"
+#include "SyntheticLandmarks.h"
+#include "TrackingPipeline.h"
+#include "TripleBuffer.h"
+#include "ViewRenderer.h"
+#include <chrono>
+#include <fstream>
+#include <random>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace soak {
+namespace {
+
+const float kFps = 30.f;
+// Windows left out of the trends while buffers reach their working size.
+const int kWarmupWindows = 1;
+
+// Capture timestamps of a camera that started uptimeSeconds ago: frame
+// periods jitter by up to 15% and about one frame in 200 is dropped.
+class ScriptClock {
+public:
+    ScriptClock(double uptimeSeconds, unsigned seed) : now_(uptimeSeconds), rng_(seed) {}
+    double next() {
+        const double period = 1.0 / kFps;
+        now_ += period * (1.0 + jitter_(rng_));
+        if (drop_(rng_)) now_ += period;
+        return now_;
+    }
+private:
+    double now_;
+    std::mt19937 rng_;
+    std::uniform_real_distribution<double> jitter_{ -0.15, 0.15 };
+    std::bernoulli_distribution drop_{ 1.0 / 200.0 };
+};
+
+enum Phase { IDLE, WALK_IN, HOLD, SMILE, DROOP, LOST, RESTLESS, WALK_OUT };
+
+struct Step {
+    Phase phase;
+    float seconds;
+};
+
+enum Expect { NO_VERDICT, NORMAL, ABNORMAL };
+
+struct Script {
+    const char* name;
+    Expect expect;
+    std::vector<Step> steps;
+};
+
+// One session each, started as a key press would, in this order.
+const std::vector<Script>& scripts() {
+    static const std::vector<Script> s = {
+        { "normal",   NORMAL,     { { IDLE, 2.f }, { WALK_IN, 1.f }, { HOLD, 2.5f }, { SMILE, 2.f }, { WALK_OUT, 1.f } } },
+        { "droop",    ABNORMAL,   { { IDLE, 1.f }, { WALK_IN, 1.f }, { HOLD, 2.5f }, { DROOP, 2.f }, { WALK_OUT, 1.f } } },
+        { "lost",     NORMAL,     { { WALK_IN, 1.f }, { HOLD, 1.f }, { LOST, 0.5f }, { HOLD, 2.5f }, { SMILE, 2.f },
+                                    { WALK_OUT, 1.f } } },
+        { "restless", NORMAL,     { { WALK_IN, 1.f }, { RESTLESS, 3.f }, { HOLD, 2.5f }, { SMILE, 2.f }, { WALK_OUT, 1.f } } },
+        { "abandon",  NO_VERDICT, { { WALK_IN, 1.f }, { HOLD, 1.f }, { WALK_OUT, 1.f }, { IDLE, 3.f } } },
+    };
+    return s;
+}
+
+// The face where the guide oval of a reference frame expects it.
+const glm::vec2 kCenter(640.f, 400.f);
+
+// Pose at u (0..1) through a phase; false when nobody is in view.
+bool pose(Phase phase, float u, std::mt19937& rng, synth::FacePose& p) {
+    auto ease = [](float x) { return x * x * (3.f - 2.f * x); };
+    const float kSmileRamp = 0.15f; // share of the phase the smile takes to form
+    p.smileLeft = p.smileRight = 0.f;
+    switch (phase) {
+        case IDLE:
+        case LOST:
+            return false;
+        case WALK_IN:
+            p.center = kCenter + glm::vec2(300.f * (1.f - ease(u)), 0.f);
+            p.iod = 50.f + 14.f * ease(u);
+            return true;
+        case HOLD:
+            p.center = kCenter;
+            p.iod = 64.f;
+            return true;
+        case SMILE:
+        case DROOP: {
+            float s = ofClamp(u / kSmileRamp, 0.f, 1.f);
+            p.center = kCenter;
+            p.iod = 64.f;
+            p.smileLeft = s;
+            p.smileRight = phase == DROOP ? 0.2f * s : s;
+            return true;
+        }
+        case RESTLESS: {
+            std::normal_distribution<float> drift(0.f, 4.f);
+            p.center += glm::vec2(drift(rng), drift(rng));
+            p.center = glm::vec2(ofClamp(p.center.x, 600.f, 680.f), ofClamp(p.center.y, 370.f, 430.f));
+            p.iod = 64.f;
+            return true;
+        }
+        case WALK_OUT:
+            p.center = kCenter - glm::vec2(350.f * ease(u), 0.f);
+            return true;
+    }
+    return false;
+}
+
+struct Window {
+    uint64_t frames = 0;
+    double   p50Us = 0, p95Us = 0, p99Us = 0;
+    uint64_t rssKb = 0;
+    uint64_t sessions = 0;
+};
+
+// Theil-Sen slope of ys against their index: the median of all pairwise
+// slopes, so a window or two hit by the scheduler does not make a trend.
+double slope(const std::vector<double>& ys) {
+    std::vector<double> s;
+    for (size_t i = 0; i < ys.size(); ++i) {
+        for (size_t j = i + 1; j < ys.size(); ++j) s.push_back((ys[j] - ys[i]) / double(j - i));
+    }
+    if (s.empty()) return 0.0;
+    std::nth_element(s.begin(), s.begin() + s.size() / 2, s.end());
+    return s[s.size() / 2];
+}
+
+// Growth of one series over the measured windows; logs it and returns
+// whether it stays within limit.
+bool withinTrend(const char* what, const std::vector<double>& ys, double limit, const char* unit) {
+    double growth = slope(ys) * double(ys.size() > 1 ? ys.size() - 1 : 0);
+    std::string line = std::string(what) + " trend " + ofToString(growth, 2) + " " + unit + " over the run (limit " +
+                       ofToString(limit, 2) + ")";
+    if (growth > limit) {
+        ofLogError("soak") << line;
+        return false;
+    }
+    ofLogNotice("soak") << line;
+    return true;
+}
+
+} // namespace
+
+uint64_t residentKb() {
+#if defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    return info.resident_size / 1024;
+#else
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    if (!(statm >> size >> resident)) return 0;
+    return resident * (uint64_t)sysconf(_SC_PAGESIZE) / 1024;
+#endif
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t frames = 1000000;
+    int      windows = 20;
+    double   tolerance = 0.10; // latency growth, share of the median window ...
+    double   latencySlackUs = 0.5; // ... or this, whichever is larger: clock and CPU frequency noise
+    double   rssSlackKb = 1024;
+    double   uptimeDays = 21;
+    unsigned seed = 1;
+    std::string csvPath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if      (a == "--frames")       frames = (uint64_t)ofToDouble(value());
+        else if (a == "--windows")      windows = ofToInt(value());
+        else if (a == "--tolerance")    tolerance = ofToDouble(value());
+        else if (a == "--latency-slack-us") latencySlackUs = ofToDouble(value());
+        else if (a == "--rss-slack-kb") rssSlackKb = ofToDouble(value());
+        else if (a == "--uptime-days")  uptimeDays = ofToDouble(value());
+        else if (a == "--seed")         seed = (unsigned)ofToInt(value());
+        else if (a == "--csv")          csvPath = value();
+        else {
+            ofLogError("soak") << "usage: --soak [--frames n] [--windows n] [--tolerance f] [--latency-slack-us n] "
+                                  "[--rss-slack-kb n] [--uptime-days d] [--seed n] [--csv out.csv]";
+            return 2;
+        }
+    }
+    if (windows < kWarmupWindows + 3 || frames < (uint64_t)windows) {
+        ofLogError("soak") << "need at least " << kWarmupWindows + 3 << " windows of one frame or more";
+        return 2;
+    }
+
+    // The tracker thread's side: its result as the tracker leaves it, the
+    // flow and the hand-off to the render thread, whose side fills RenderData.
+    const guide::GuideGeometry geometry = guide::geometryFor(guide::kReferenceWidth, guide::kReferenceHeight);
+    ScriptClock clock(uptimeDays * 86400.0, seed);
+    FrameInterval interval;
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0.f, 0.3f);
+    std::vector<TrackedFace> faces;
+    DerolledData der;
+    SmileFlow flow;
+    TripleBuffer<TrackingPipeline::Result> results;
+    RenderData rd;
+    ViewRenderer::LayerKeys keys;
+    synth::FacePose p;
+    p.roll = 0.08f;
+
+    const uint64_t perWindow = frames / windows;
+    std::vector<float> latencyUs;
+    latencyUs.reserve(perWindow + frames % windows);
+    std::vector<Window> stats;
+    size_t script = 0, step = 0;
+    float  stepTime = 0.f;
+    uint64_t sessions = 0, wrongVerdicts = 0;
+
+    flow.reset();
+    for (uint64_t f = 0; f < frames; ++f) {
+        const double time = clock.next();
+        const float dt = interval.next(time);
+
+        // Script position; a finished script is judged and the next one starts.
+        const Script* s = &scripts()[script];
+        while (stepTime >= s->steps[step].seconds) {
+            stepTime -= s->steps[step].seconds;
+            if (++step < s->steps.size()) continue;
+            const Expect got = flow.stage() != SmileFlow::STAGE_EVALUATE ? NO_VERDICT
+                             : flow.abnormal() ? ABNORMAL : NORMAL;
+            if (got != s->expect) {
+                wrongVerdicts++;
+                ofLogWarning("soak") << "session " << sessions << " (" << s->name << ") ended "
+                                     << (got == NO_VERDICT ? "without a verdict" : got == ABNORMAL ? "abnormal" : "normal");
+            }
+            sessions++;
+            step = 0;
+            script = (script + 1) % scripts().size();
+            s = &scripts()[script];
+            flow.reset();
+        }
+        const Step& st = s->steps[step];
+        const bool hasFace = pose(st.phase, stepTime / st.seconds, rng, p);
+        stepTime += dt;
+
+        // What FaceTrackerAdapter leaves behind for the frame: the subject or nobody.
+        faces.resize(hasFace ? 1 : 0);
+        if (hasFace) {
+            TrackedFace& face = faces.front();
+            synth::makeFace(p, face.points);
+            for (auto& q : face.points) q += glm::vec2(noise(rng), noise(rng));
+            face.points.frame = f;
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        const bool haveDer = hasFace && FaceTrackerAdapter::deroll(faces.front().points, geometry.oval, der);
+        flow.update(makeFlowInputs(hasFace, haveDer, der, dt));
+
+        TrackingPipeline::Result& r = results.back();
+        TrackingPipeline::fillResult(r, faces, der, flow, f);
+        r.ready = true;
+        results.publish();
+
+        if (results.fetch()) {
+            fillRenderData(results.front(), rd);
+            rd.geometry = geometry;
+            ViewRenderer::layerKeys(rd, keys);
+        }
+        latencyUs.push_back(std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - t0).count());
+
+        // The last window takes the remainder.
+        const bool last = f + 1 == frames;
+        if ((latencyUs.size() == perWindow && (int)stats.size() + 1 < windows) || last) {
+            Window w;
+            w.frames   = latencyUs.size();
+            w.p50Us    = stats::percentile(latencyUs, 0.50);
+            w.p95Us    = stats::percentile(latencyUs, 0.95);
+            w.p99Us    = stats::percentile(latencyUs, 0.99);
+            w.rssKb    = residentKb();
+            w.sessions = sessions;
+            stats.push_back(w);
+            latencyUs.clear();
+            ofLogNotice("soak") << "window " << stats.size() << "/" << windows << ": p50 " << ofToString(w.p50Us, 2)
+                                << " us, p95 " << ofToString(w.p95Us, 2) << " us, p99 " << ofToString(w.p99Us, 2)
+                                << " us, rss " << w.rssKb << " kB, " << sessions << " sessions";
+        }
+    }
+
+    if (!csvPath.empty()) {
+        std::ofstream out(ofToDataPath(csvPath, true));
+        out << "window,frames,p50_us,p95_us,p99_us,rss_kb,sessions\n";
+        for (size_t i = 0; i < stats.size(); ++i) {
+            const Window& w = stats[i];
+            out << i << "," << w.frames << "," << w.p50Us << "," << w.p95Us << "," << w.p99Us << "," << w.rssKb
+                << "," << w.sessions << "\n";
+        }
+        if (!out) ofLogError("soak") << "cannot write " << csvPath;
+    }
+
+    // Latency may grow by tolerance of its median window or by its slack,
+    // memory by its slack.
+    std::vector<double> p50, p95, rss;
+    for (size_t i = kWarmupWindows; i < stats.size(); ++i) {
+        p50.push_back(stats[i].p50Us);
+        p95.push_back(stats[i].p95Us);
+        rss.push_back((double)stats[i].rssKb);
+    }
+    auto median = [](std::vector<double> v) {
+        std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+        return v[v.size() / 2];
+    };
+    bool ok = withinTrend("p50 latency", p50, std::max(tolerance * median(p50), latencySlackUs), "us");
+    ok = withinTrend("p95 latency", p95, std::max(tolerance * median(p95), latencySlackUs), "us") && ok;
+    if (rss.back() > 0) ok = withinTrend("resident memory", rss, rssSlackKb, "kB") && ok;
+    else ofLogWarning("soak") << "resident memory unknown on this platform";
+
+    ofLogNotice("soak") << frames << " frames, " << sessions << " sessions, " << wrongVerdicts << " wrong verdicts";
+    return ok && wrongVerdicts == 0 ? 0 : 1;
+}
+
+} // namespace soak
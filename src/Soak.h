@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+// Uptime soak for the per-frame data path: scripted sessions (walk in,
+// hold, smile, face lost, walk away, reset) of synthetic landmarks through
+// deroll -> SmileFlow -> result hand-off -> render data and layer keys,
+// stamped by a deterministic clock that starts weeks into uptime. The run
+// is cut into windows; latency percentiles and resident memory are taken
+// per window and the run fails when either trends upward past its
+// tolerance, or when a script does not end in its expected verdict.
+namespace soak {
+
+// Resident set size of this process in KiB, 0 when unknown.
+uint64_t residentKb();
+
+// Entry point for `--soak [--frames n] [--windows n] [--tolerance f]
+// [--latency-slack-us n] [--rss-slack-kb n] [--uptime-days d] [--seed n]
+// [--csv out.csv]`. Returns the exit code.
+int main(int argc, char* argv[]);
+
+} // namespace soak
@@ -0,0 +1,17 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+namespace stats {
+
+// Nearest-rank percentile of samples, p in [0, 1]; 0 for no samples. Takes a
+// copy, since selecting the rank reorders it.
+template <typename T>
+double percentile(std::vector<T> v, double p) {
+    if (v.empty()) return 0.0;
+    size_t k = std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+} // namespace stats
@@ -0,0 +1,108 @@
+#include "SyntheticLandmarks.h"
+#include "Landmarks68.h"
+#include "Math2D.h"
+#include <random>
+
+namespace synth {
+
+const char* scenarioName(Scenario s) {
+    switch (s) {
+        case NEUTRAL:   return "neutral";
+        case SMILE:     return "smile";
+        case DROOP:     return "droop";
+        case JITTER:    return "jitter";
+        case FACE_LOST: return "face_lost";
+        default:        return "unknown";
+    }
+}
+
+void makeFace(const FacePose& pose, LandmarkFrame& out) {
+    const float I = pose.iod;
+    const float kPi = 3.14159265f;
+    auto deg = [&](float d) { return d * kPi / 180.f; };
+
+    // Face-local coordinates: origin at the eye midpoint, +y down, units of IOD.
+    for (int i = LM_JAW_START; i <= LM_JAW_END; ++i) {
+        float t = kPi * (i - LM_JAW_START) / float(LM_JAW_END - LM_JAW_START);
+        out[i] = glm::vec2(-1.0f * std::cos(t), 0.05f + 1.55f * std::sin(t)) * I;
+    }
+    for (int k = 0; k < 5; ++k) {
+        float u = k / 4.f;
+        float arch = 0.1f * std::sin(kPi * u);
+        out[LM_LEFT_BROW_START  + k] = glm::vec2(-0.85f + 0.7f * u, -0.45f - arch) * I;
+        out[LM_RIGHT_BROW_START + k] = glm::vec2( 0.15f + 0.7f * u, -0.45f - arch) * I;
+    }
+    for (int k = 0; k <= LM_NOSE_BRIDGE_END - LM_NOSE_BRIDGE_START; ++k) {
+        out[LM_NOSE_BRIDGE_START + k] = glm::vec2(0.f, -0.1f + 0.2f * k) * I;
+    }
+    for (int k = 0; k <= LM_NOSE_BASE_END - LM_NOSE_BASE_START; ++k) {
+        out[LM_NOSE_BASE_START + k] = glm::vec2(-0.2f + 0.1f * k, k == 2 ? 0.7f : 0.65f) * I;
+    }
+    // Eyes: outer/inner corners at 180/0 degrees, lids in between.
+    const float eyeAngles[6] = { 180, 120, 60, 0, 300, 240 };
+    for (int k = 0; k < 6; ++k) {
+        glm::vec2 o(0.2f * std::cos(deg(eyeAngles[k])), -0.07f * std::sin(deg(eyeAngles[k])));
+        out[LM_LEFT_EYE_START  + k] = (glm::vec2(-0.5f, 0.f) + o) * I;
+        out[LM_RIGHT_EYE_START + k] = (glm::vec2( 0.5f, 0.f) + o) * I;
+    }
+    for (int k = 0; k <= LM_OUTER_MOUTH_END - LM_OUTER_MOUTH_START; ++k) {
+        float a = deg(180.f - 30.f * k);
+        out[LM_OUTER_MOUTH_START + k] = glm::vec2(0.4f * std::cos(a), 1.05f - 0.15f * std::sin(a)) * I;
+    }
+    for (int k = 0; k <= LM_INNER_MOUTH_END - LM_INNER_MOUTH_START; ++k) {
+        float a = deg(180.f - 45.f * k);
+        out[LM_INNER_MOUTH_START + k] = glm::vec2(0.3f * std::cos(a), 1.05f - 0.05f * std::sin(a)) * I;
+    }
+    // A smile lifts and widens the corners.
+    out[LM_LEFT_MOUTH_CORNER]  += glm::vec2(-0.08f * pose.smileLeft,  -0.15f * pose.smileLeft)  * I;
+    out[LM_RIGHT_MOUTH_CORNER] += glm::vec2( 0.08f * pose.smileRight, -0.15f * pose.smileRight) * I;
+
+    for (auto& p : out) {
+        p = math2d::rotateAround(p + pose.center, pose.center, pose.roll);
+    }
+}
+
+std::vector<SynthFrame> makeSequence(Scenario s, int frames, unsigned seed, float fps) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0.f, 0.3f);
+    std::normal_distribution<float> drift(0.f, 4.f);
+
+    std::vector<SynthFrame> seq(std::max(0, frames));
+    FacePose pose;
+    pose.roll = 0.08f;
+    int actionStart = frames * 2 / 5; // neutral hold first, long enough to calibrate
+    int rampFrames  = std::max(1, frames / 10);
+
+    for (int f = 0; f < frames; ++f) {
+        SynthFrame& fr = seq[f];
+        fr.dt = 1.f / fps;
+        float ramp = ofClamp((f - actionStart) / float(rampFrames), 0.f, 1.f);
+        pose.smileLeft = pose.smileRight = 0.f;
+        switch (s) {
+            case SMILE:
+                pose.smileLeft = pose.smileRight = ramp;
+                break;
+            case DROOP:
+                pose.smileLeft  = ramp;
+                pose.smileRight = 0.2f * ramp;
+                break;
+            case JITTER:
+                // Restless head throughout, so the hold-still stage keeps restarting.
+                pose.center += glm::vec2(drift(rng), drift(rng));
+                pose.center = glm::vec2(ofClamp(pose.center.x, 600.f, 680.f), ofClamp(pose.center.y, 370.f, 430.f));
+                break;
+            case FACE_LOST:
+                // Drops out for a quarter second every second once the action starts.
+                if (f >= actionStart && (f % int(fps)) < int(fps / 4)) continue;
+                break;
+            default: break;
+        }
+        fr.hasFace = true;
+        makeFace(pose, fr.points);
+        fr.points.frame = (uint64_t)f;
+        for (auto& p : fr.points) p += glm::vec2(noise(rng), noise(rng));
+    }
+    return seq;
+}
+
+} // namespace synth
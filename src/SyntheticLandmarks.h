@@ -0,0 +1,36 @@
+#pragma once
+#include "ofMain.h"
+#include <string>
+#include <vector>
+#include "LandmarkFrame.h"
+
+// Generated 68-point landmark streams that stand in for the camera and dlib
+// model when benchmarking or soaking the per-frame pipeline.
+namespace synth {
+
+enum Scenario { NEUTRAL = 0, SMILE, DROOP, JITTER, FACE_LOST };
+static constexpr int kNumScenarios = FACE_LOST + 1;
+const char* scenarioName(Scenario s);
+
+struct FacePose {
+    glm::vec2 center{640.f, 400.f}; // eye midpoint, 1280x720 image coordinates
+    float iod = 64.f;
+    float roll = 0.f;               // radians
+    float smileLeft = 0.f;          // 0..1 raise of each mouth corner
+    float smileRight = 0.f;
+};
+
+struct SynthFrame {
+    bool   hasFace = false;
+    float  dt = 1.f / 30.f;
+    LandmarkFrame points; // unused when !hasFace
+};
+
+// A single face in the given pose, landmark order as in Landmarks68.h.
+void makeFace(const FacePose& pose, LandmarkFrame& out);
+
+// A deterministic sequence: a neutral hold followed by the scenario's action
+// (JITTER moves the head from the first frame).
+std::vector<SynthFrame> makeSequence(Scenario s, int frames, unsigned seed = 1, float fps = 30.f);
+
+} // namespace synth
@@ -0,0 +1,257 @@
+#include "TrackingPipeline.h"
+#include "FlowInputs.h"
+#include "Profiler.h"
+#include <chrono>
+
+namespace {
+// How long the capture thread sleeps before polling the grabber again.
+const auto kPollInterval = std::chrono::milliseconds(1);
+
+// Smoothing of the frame rates reported in Result.
+const float kFpsSmoothing = 0.1f;
+
+float smoothFps(float fps, double dt) {
+    if (dt <= 0.0) return fps;
+    return fps <= 0.f ? float(1.0 / dt) : fps + kFpsSmoothing * (float(1.0 / dt) - fps);
+}
+}
+
+TrackingPipeline::~TrackingPipeline() {
+    stop();
+}
+
+void TrackingPipeline::setup(const Settings& s, FairGate* gate) {
+    stop();
+    settings_ = s;
+    gate_ = gate;
+    trackFps_ = 0.f;
+    cameraFps_ = 0.f;
+    if (auto d = detectors::make(s.detector)) tracker_.setDetector(std::move(d));
+    tracker_.setTrackingScale(s.trackingScale);
+    tracker_.setInferencePolicy(s.inference);
+    tracker_.setFrameGate(s.gate);
+    quality_.setup(s.quality);
+    quality_.apply(tracker_);
+    flow_ = SmileFlow();
+    metrics::Registry* registry = s.metrics ? &metrics::Registry::global() : nullptr;
+    tracker_.setMetrics(registry, { { "station", s.station } });
+    flow_.setMetrics(registry, { { "station", s.station } });
+    recordPath_ = s.recordPath;
+    capturing_ = false;
+    if (!s.sessions.dir.empty()) sessions_.start(s.sessions);
+
+    // Opening the camera and loading the model both take a while, so each
+    // happens on the thread that needs it and the render thread is free to
+    // show the home screen straight away.
+    running_ = true;
+    captureThread_ = std::thread(&TrackingPipeline::captureLoop, this);
+    trackThread_ = std::thread(&TrackingPipeline::trackLoop, this);
+}
+
+void TrackingPipeline::stop() {
+    running_ = false;
+    wakeTracker();
+    if (captureThread_.joinable()) captureThread_.join();
+    if (trackThread_.joinable())   trackThread_.join();
+    recorder_.close();
+    sessions_.stop();
+    if (grabber_.isInitialized())  grabber_.close();
+}
+
+void TrackingPipeline::captureLoop() {
+    // Pixels only: the render thread uploads its own texture.
+    grabber_.setUseTexture(false);
+    if (settings_.deviceId >= 0) grabber_.setDeviceID(settings_.deviceId);
+    if (!grabber_.setup(settings_.camWidth, settings_.camHeight)) {
+        ofLogError("TrackingPipeline") << "cannot open camera " << settings_.deviceId;
+        return;
+    }
+    uint64_t index = 0;
+    double lastTime = -1.0;
+    float fps = 0.f;
+    while (running_) {
+        {
+            PROFILE_SCOPE(prof::GRAB);
+            grabber_.update();
+        }
+        if (!grabber_.isFrameNew()) {
+            std::this_thread::sleep_for(kPollInterval);
+            continue;
+        }
+        const ofPixels& pixels = grabber_.getPixels();
+        // Not ofGetElapsedTimef(): after weeks of uptime a float only
+        // resolves an eighth of a second and dt would collapse to 0.
+        double now = ofGetElapsedTimeMicros() * 1e-6;
+        if (lastTime >= 0.0) fps = smoothFps(fps, now - lastTime);
+        lastTime = now;
+        cameraFps_.store(fps, std::memory_order_relaxed);
+
+        CameraFrame& t = toTracker_.back();
+        t.pixels = pixels;
+        t.time = now;
+        t.index = index;
+        if (!toTracker_.publish()) PROFILE_DROPPED();
+        wakeTracker();
+
+        CameraFrame& r = frames_.back();
+        r.pixels = pixels;
+        r.time = now;
+        r.index = index;
+        frames_.publish();
+
+        index++;
+    }
+}
+
+void TrackingPipeline::trackLoop() {
+    auto model = LandmarkModel::shared(settings_.modelPath);
+    if (!running_) return;
+    if (!model) ofLogError("TrackingPipeline") << "no landmark model, faces will not be tracked";
+    tracker_.setup(model);
+    // Keys pressed while loading are not queued; the flow starts gated.
+    resetRequested_ = false;
+    startRequested_ = false;
+    ready_ = true;
+    publishResult(0);
+
+    FrameInterval interval;
+    SubjectWatch  subjects;
+    uint64_t lastIndex = 0;
+    while (running_) {
+        bool requested = false;
+        if (resetRequested_.exchange(false)) {
+            flow_.reset();
+            capturing_ = false;
+            sessionStartPending_ = true;
+            requested = true;
+        }
+        if (startRequested_.exchange(false) && flow_.stage() == SmileFlow::STAGE_HOME) {
+            flow_.reset();
+            sessionStartPending_ = true;
+            requested = true;
+        }
+        // Shown now, not with the next frame: the camera may be slow or gone.
+        if (requested) publishResult(lastIndex);
+
+        bool fresh = false;
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wake_.wait(lock, [&] {
+                return !running_ || resetRequested_ || startRequested_ || (fresh = toTracker_.fetch());
+            });
+        }
+        if (!fresh) continue;
+        CameraFrame& frame = toTracker_.front();
+        lastIndex = frame.index;
+        double trackSeconds;
+        {
+            // Time spent waiting for a turn is not the tracker's, so the
+            // quality controller only sees the update itself.
+            FairGate::Scope turn(gate_);
+            auto trackStart = std::chrono::steady_clock::now();
+            tracker_.update(frame.pixels);
+            trackSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - trackStart).count();
+        }
+        if (quality_.update(trackSeconds)) {
+            quality_.apply(tracker_);
+        }
+
+        // A new person in the oval starts the screening over.
+        if (subjects.changed(tracker_.subject(), flow_.stage())) {
+            ofLogNotice("TrackingPipeline") << "subject changed, screening restarted";
+            flow_.reset();
+            capturing_ = false;
+            sessionStartPending_ = true;
+        }
+
+        // The flow advances by capture time, so skipped frames still count.
+        float dt = interval.next(frame.time);
+        trackFps_ = smoothFps(trackFps_, dt);
+        SmileFlow::Inputs in = makeFlowInputs(tracker_, der_, dt);
+        SmileFlow::Stage before = flow_.stage();
+        {
+            PROFILE_SCOPE(prof::FLOW);
+            flow_.update(in);
+        }
+        publishResult(frame.index);
+
+        // Only frames that are part of a session; the home screen and a
+        // finished verdict tell a replay nothing.
+        if (!recordPath_.empty() && before != SmileFlow::STAGE_HOME && before != SmileFlow::STAGE_EVALUATE) {
+            record(frame);
+        }
+        if (sessions_.running()) capture(frame);
+    }
+}
+
+void TrackingPipeline::record(const CameraFrame& frame) {
+    if (!recorder_.isOpen()) {
+        const guide::GuideGeometry& g = tracker_.geometry();
+        if (!recorder_.open(recordPath_, g.frameWidth, g.frameHeight)) {
+            recordPath_.clear();
+            return;
+        }
+    }
+    const bool hasFace = tracker_.hasFace();
+    fillRecord(recorder_.next(), frame.time, hasFace, hasFace ? &tracker_.faces().front().points : nullptr,
+               der_, sessionStartPending_, tracker_.measured());
+    recorder_.commit();
+    sessionStartPending_ = false;
+}
+
+// From the first hold-still frame up to and including the verdict.
+void TrackingPipeline::capture(const CameraFrame& frame) {
+    const SmileFlow::Stage stage = flow_.stage();
+    bool first = false;
+    if (!capturing_) {
+        if (stage != SmileFlow::STAGE_HOLD_STILL) return;
+        capturing_ = true;
+        first = true;
+        sessionId_++;
+    }
+    const bool last = stage == SmileFlow::STAGE_EVALUATE;
+    SessionRecorder::Frame& f = sessions_.next();
+    f.session   = sessionId_;
+    f.last      = last;
+    f.pixels    = frame.pixels;
+    const bool hasFace = tracker_.hasFace();
+    fillRecord(f.record, frame.time, hasFace, hasFace ? &tracker_.faces().front().points : nullptr,
+               der_, first, tracker_.measured());
+    f.oval      = tracker_.geometry().oval;
+    f.stage     = stage;
+    f.progress  = flow_.stabilityProgress();
+    f.intensity = flow_.smileIntensity();
+    f.asymmetry = flow_.smileAsymmetry();
+    f.abnormal  = flow_.abnormal();
+    sessions_.publish();
+    if (last) capturing_ = false;
+}
+
+void TrackingPipeline::fillResult(Result& r, const std::vector<TrackedFace>& faces, const DerolledData& der,
+                                  const SmileFlow& flow, uint64_t frameIndex) {
+    r.faces             = faces;
+    r.der               = der;
+    r.stage             = flow.stage();
+    r.abnormal          = flow.abnormal();
+    r.lines             = flow.uiLines();
+    r.stabilityProgress = flow.stabilityProgress();
+    r.smileIntensity    = flow.smileIntensity();
+    r.smileAsymmetry    = flow.smileAsymmetry();
+    r.frameIndex        = frameIndex;
+}
+
+void TrackingPipeline::wakeTracker() {
+    // Taking the lock orders the change before the tracker's next check,
+    // so it cannot test, miss the change and then sleep through the notify.
+    { std::lock_guard<std::mutex> lock(wakeMutex_); }
+    wake_.notify_one();
+}
+
+void TrackingPipeline::publishResult(uint64_t frameIndex) {
+    Result& r = results_.back();
+    fillResult(r, tracker_.faces(), der_, flow_, frameIndex);
+    r.ready             = ready_;
+    r.cameraFps         = cameraFps_.load(std::memory_order_relaxed);
+    r.trackFps          = trackFps_;
+    results_.publish();
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "ofMain.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "FairGate.h"
+#include "FaceTrackerAdapter.h"
+#include "LandmarkRecording.h"
+#include "QualityController.h"
+#include "SessionRecorder.h"
+#include "SmileFlow.h"
+#include "TripleBuffer.h"
+
+// Live camera pipeline. A capture thread owns the grabber, a tracker thread
+// owns the FaceTrackerAdapter and SmileFlow, and the render (GL) thread picks
+// up the newest camera frame and the newest tracking result. Stages hand off
+// through TripleBuffers, so a slow landmark pass never stalls drawing and
+// frames that arrive while the tracker is busy are dropped, not queued.
+class TrackingPipeline {
+public:
+    struct Settings {
+        std::string modelPath = "model/shape_predictor_68_face_landmarks.dat";
+        int   deviceId  = -1;    // ofVideoGrabber device; -1 for the default camera
+        int   camWidth  = 1280;  // requested; the geometry follows what the camera delivers
+        int   camHeight = 720;
+        float trackingScale = 1.f; // see FaceTrackerAdapter::setTrackingScale
+        std::string detector = "hog"; // see detectors::make
+        FaceTrackerAdapter::InferencePolicy inference;
+        FrameGate::Settings gate;
+        // With a budget the controller's levels replace trackingScale,
+        // detection.fullFrameEvery and inference.every.
+        QualityController::Settings quality;
+        std::string recordPath;    // non-empty: append session frames to this .lmk file
+        SessionRecorder::Settings sessions; // dir non-empty: keep an audit copy of each session
+        bool metrics = false;      // report to metrics::Registry::global()
+        std::string station = "1"; // the metrics' station label
+    };
+
+    struct CameraFrame {
+        ofPixels pixels;
+        double   time = 0.0; // seconds since the app started, at capture
+        uint64_t index = 0;
+    };
+
+    // Everything the renderer needs from one tracked frame.
+    struct Result {
+        std::vector<TrackedFace> faces;
+        DerolledData      der;
+        SmileFlow::Stage  stage = SmileFlow::STAGE_HOME;
+        bool              abnormal = false;
+        SmileFlow::UiText lines;
+        float    stabilityProgress = 0.f;
+        float    smileIntensity = 0.f;
+        float    smileAsymmetry = 0.f;
+        uint64_t frameIndex = 0;
+        bool     ready = false; // model loaded; the flow takes requests
+        float    cameraFps = 0.f; // frames delivered by the camera
+        float    trackFps = 0.f;  // frames the tracker got through
+    };
+    // Everything in r that comes from the tracker and the flow for one frame;
+    // ready and the frame rates are left to the caller.
+    static void fillResult(Result& r, const std::vector<TrackedFace>& faces, const DerolledData& der,
+                           const SmileFlow& flow, uint64_t frameIndex);
+
+    ~TrackingPipeline();
+
+    // Starts both threads and returns at once. The capture thread opens the
+    // camera; the tracker thread loads the model and only then takes frames
+    // and requests, which Result::ready reports. Without a camera the flow
+    // still answers requests, there are just no frames. Pipelines given the
+    // same gate take turns at tracking instead of competing for the cores.
+    void setup(const Settings& s, FairGate* gate = nullptr);
+    void stop();
+
+    // Render thread only. newFrame()/newResult() are true when the matching
+    // accessor now returns something newer than on the previous call.
+    bool newFrame()  { return frames_.fetch(); }
+    bool newResult() { return results_.fetch(); }
+    const CameraFrame& frame() const  { return frames_.front(); }
+    const Result&      result() const { return results_.front(); }
+
+    // Handled by the tracker thread straight away, whether or not frames
+    // are arriving; the next result shows the outcome.
+    void requestReset() { resetRequested_ = true; wakeTracker(); }
+    // Starts a session if the flow is still on the home screen.
+    void requestStart() { startRequested_ = true; wakeTracker(); }
+
+private:
+    void captureLoop();
+    void trackLoop();
+    void publishResult(uint64_t frameIndex);
+    // After a new frame, request or stop; the tracker thread sleeps until one.
+    void wakeTracker();
+    void record(const CameraFrame& frame);
+    void capture(const CameraFrame& frame);
+
+    Settings           settings_;
+    ofVideoGrabber     grabber_;     // capture thread
+    FaceTrackerAdapter tracker_;     // tracker thread
+    SmileFlow          flow_;        // tracker thread
+    DerolledData       der_;         // tracker thread
+    LandmarkRecorder   recorder_;    // tracker thread
+    QualityController  quality_;     // tracker thread
+    SessionRecorder    sessions_;    // fed by the tracker thread
+    bool               capturing_ = false; // tracker thread
+    uint64_t           sessionId_ = 0;
+    std::string        recordPath_;
+    bool               sessionStartPending_ = false;
+    bool               ready_ = false; // tracker thread
+    float              trackFps_ = 0.f; // tracker thread
+    FairGate*          gate_ = nullptr;
+    std::atomic<float> cameraFps_{0.f};
+
+    TripleBuffer<CameraFrame> toTracker_;
+    TripleBuffer<CameraFrame> frames_;  // to the render thread
+    TripleBuffer<Result>      results_;
+
+    std::thread       captureThread_, trackThread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> resetRequested_{false};
+    std::atomic<bool> startRequested_{false};
+    std::mutex              wakeMutex_;
+    std::condition_variable wake_;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer / single-consumer hand-off of the newest value.
+// The producer fills back() and publish()es it; the consumer fetch()es and
+// reads front(). Neither side ever waits: a value published before the
+// previous one was fetched simply replaces it, so stale data is dropped
+// rather than queued. Slots are reused, so T's buffers keep their capacity.
+template <class T>
+class TripleBuffer {
+public:
+    // Producer side.
+    T& back() { return slots_[back_]; }
+    // Returns false when it replaced a value the consumer never fetched.
+    bool publish() {
+        uint8_t prev = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+        back_ = prev & kIndex;
+        return !(prev & kFresh);
+    }
+
+    // Consumer side. True when front() now holds a newer value.
+    bool fetch() {
+        if (!(middle_.load(std::memory_order_relaxed) & kFresh)) return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+    const T& front() const { return slots_[front_]; }
+    T&       front()       { return slots_[front_]; }
+
+private:
+    static constexpr uint8_t kIndex = 0x3;
+    static constexpr uint8_t kFresh = 0x4;
+
+    std::array<T, 3>     slots_{};
+    uint8_t              back_  = 0; // producer only
+    uint8_t              front_ = 1; // consumer only
+    std::atomic<uint8_t> middle_{2};
+};
@@ -1,42 +1,216 @@
 #include "ViewRenderer.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace {
+// How often the frame-rate readout is refreshed. It is the only thing on
+// screen that changes without new data, so it bounds the idle recompose rate.
+const float kStatsInterval = 0.5f;
+// Text sizes kept per font; the progress and smile readouts keep producing
+// new strings, so the cache starts over once it is this full.
+const size_t kMaxCachedStrings = 256;
+
+const std::string kTitle = "Facial Stroke Detector";
+const std::vector<std::string> kHomeLines = {
+    "Welcome!", "",
+    "How it works:",
+    "- Align your head inside the oval",
+    "- Hold still until progress completes",
+    "- Show your teeth (smile)",
+    "- System checks for mouth asymmetry", "", "Press any key to begin"
+};
+const std::string kLoading = "Loading face model...";
+const std::string kNormal = "NORMAL", kAbnormal = "ABNORMALITY DETECTED";
+
+int pixels(float units, float scale) {
+    return std::max(1, (int)std::ceil(units * scale));
+}
+
+// Layers are drawn onto transparent buffers with premultiplied alpha, so a
+// translucent panel keeps its opacity once composited over the camera.
+void beginLayer(ofFbo& fbo, float scale) {
+    fbo.begin();
+    ofClear(0, 0, 0, 0);
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    ofPushMatrix();
+    ofScale(scale, scale);
+}
+
+void endLayer(ofFbo& fbo) {
+    ofPopMatrix();
+    ofEnableAlphaBlending();
+    fbo.end();
+}
+
+void drawLayer(const ofFbo& fbo, float x, float y, float w, float h) {
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    ofSetColor(255);
+    fbo.draw(x, y, w, h);
+    ofEnableAlphaBlending();
+}
+} // namespace
+
+void fillRenderData(const TrackingPipeline::Result& res, RenderData& rd) {
+    rd.stage             = res.stage;
+    rd.ready             = res.ready;
+    rd.abnormal          = res.abnormal;
+    rd.insideGuide       = res.der.valid && res.der.insideGuide;
+    rd.lines             = &res.lines;
+    rd.stabilityProgress = res.stabilityProgress;
+    rd.smileIntensity    = res.smileIntensity;
+    rd.smileAsymmetry    = res.smileAsymmetry;
+    rd.faces             = &res.faces;
+    rd.cameraFps         = res.cameraFps;
+    rd.trackFps          = res.trackFps;
+}
+
+void ViewRenderer::layerKeys(const RenderData& rd, LayerKeys& keys) {
+    keys.home = rd.ready ? "ready" : "loading";
+    keys.lines.clear();
+    if (rd.lines) {
+        for (const auto& line : *rd.lines) {
+            keys.lines += line;
+            keys.lines += '\n';
+        }
+    }
+    keys.banner = rd.abnormal ? kAbnormal : kNormal;
+}
+
+bool ViewRenderer::Layer::stale(const std::string& k, int w, int h) {
+    const bool sized = fbo.isAllocated() && (int)fbo.getWidth() == w && (int)fbo.getHeight() == h;
+    if (sized && key == k) return false;
+    if (!sized) fbo.allocate(w, h, GL_RGBA);
+    key = k;
+    return true;
+}
+
+glm::vec2 ViewRenderer::textSize(ofTrueTypeFont& font, const std::string& s) {
+    auto& sizes = textSizes_[&font];
+    auto it = sizes.find(s);
+    if (it != sizes.end()) return it->second;
+    if (sizes.size() >= kMaxCachedStrings) sizes.clear();
+    glm::vec2 size(font.stringWidth(s), font.stringHeight(s));
+    sizes.emplace(s, size);
+    return size;
+}
 
 void ViewRenderer::draw(const RenderData& rd) {
-    ofBackground(15, 15, 15);
+    ofRectangle viewport = rd.viewport;
+    if (viewport.isEmpty()) viewport.set(0, 0, ofGetWidth(), ofGetHeight());
+    const int w = std::max(1, (int)std::lround(viewport.width));
+    const int h = std::max(1, (int)std::lround(viewport.height));
+    if (!frame_.isAllocated() || (int)frame_.getWidth() != w || (int)frame_.getHeight() != h) {
+        frame_.allocate(w, h, GL_RGB);
+        dirty_ = true;
+    }
 
-    if (!rd.grabber || !rd.grabber->isInitialized() || !rd.grabber->getPixels().isAllocated()) {
-        ofSetColor(0, 0, 255);
-        ofDrawRectangle(0, 0, ofGetWidth(), ofGetHeight());
-        ofSetColor(255);
-        ofDrawBitmapString("Camera not initialized! Check camera connection and permissions.", 40, 80);
-        return;
+    float now = ofGetElapsedTimef();
+    if (statsAt_ < 0.f || now - statsAt_ >= kStatsInterval) {
+        statsAt_ = now;
+        std::string stats = "Framerate : " + ofToString(ofGetFrameRate(), 1) + "\n"
+                          + (rd.label.empty() ? "" : rd.label + "  ") + "camera " + ofToString(rd.cameraFps, 1)
+                          + " fps, tracking " + ofToString(rd.trackFps, 1) + " fps";
+#if STROKE_PROFILE
+        stats += "\n" + prof::overlayText();
+#endif
+        if (stats != stats_) {
+            stats_ = std::move(stats);
+            dirty_ = true;
+        }
     }
 
+    if (dirty_) {
+        PROFILE_SCOPE(prof::DRAW);
+        const float scale = std::min(viewport.width / ofGetWidth(), viewport.height / ofGetHeight());
+        compose(rd, int(viewport.width / scale), int(viewport.height / scale), scale);
+        dirty_ = false;
+        composed_++;
+    }
     ofSetColor(255);
-    int winW = ofGetWidth();
-    int winH = ofGetHeight();
+    frame_.draw(viewport.x, viewport.y);
+}
 
+void ViewRenderer::compose(const RenderData& rd, int winW, int winH, float scale) {
     ofTrueTypeFont& instrFont  = *rd.fontMedium;
     ofTrueTypeFont& bannerFont = *rd.fontLarge;
+    const bool haveCamera = rd.camera && rd.camera->isAllocated();
+
+    static const SmileFlow::UiText kNoLines;
+    const SmileFlow::UiText& lines = rd.lines ? *rd.lines : kNoLines;
+    layerKeys(rd, keys_);
+
+    // Layers first; their buffers cannot be drawn into while frame_ is bound.
+    if (haveCamera && rd.stage == SmileFlow::STAGE_HOME &&
+        home_.stale(keys_.home, pixels(winW, scale), pixels(winH, scale))) {
+        beginLayer(home_.fbo, scale);
+        ofSetColor(30, 30, 30, 180);
+        ofDrawRectangle(0, 0, winW, winH);
+        ofSetColor(255);
+        bannerFont.drawString(kTitle, winW/2 - textSize(bannerFont, kTitle).x/2, winH/5);
+        for (size_t i = 0; i < kHomeLines.size(); ++i) {
+            const std::string& line = (i + 1 == kHomeLines.size() && !rd.ready) ? kLoading : kHomeLines[i];
+            instrFont.drawString(line, winW/2 - textSize(instrFont, line).x/2, winH/5 + 80 + i*38);
+        }
+        endLayer(home_.fbo);
+    }
 
     float maxWidth = 0, totalHeight = 0;
-    for (const auto& line : rd.lines) {
-        maxWidth = std::max(maxWidth, instrFont.stringWidth(line));
-        totalHeight += instrFont.stringHeight(line) + 8;
+    for (const auto& line : lines) {
+        glm::vec2 size = textSize(instrFont, line);
+        maxWidth = std::max(maxWidth, size.x);
+        totalHeight += size.y + 8;
+    }
+    const float boxW = maxWidth + 40, boxH = totalHeight + 24;
+    if (haveCamera && rd.stage != SmileFlow::STAGE_HOME &&
+        instructions_.stale(keys_.lines, pixels(boxW, scale), pixels(boxH, scale))) {
+        beginLayer(instructions_.fbo, scale);
+        ofSetColor(0, 0, 0, 100);
+        ofDrawRectangle(0, 0, boxW, boxH);
+        ofSetColor(255);
+        float y = 18;
+        for (const auto& line : lines) {
+            glm::vec2 size = textSize(instrFont, line);
+            instrFont.drawString(line, boxW/2 - size.x/2, y + size.y);
+            y += size.y + 8;
+        }
+        endLayer(instructions_.fbo);
     }
 
-    float bannerHeight = 0, bannerW = 0;
-    std::string result = "";
-    ofColor resultColor;
-    if (rd.stage == SmileFlow::STAGE_EVALUATE) {
-        result = rd.abnormal ? "ABNORMALITY DETECTED" : "NORMAL";
-        resultColor = rd.abnormal ? ofColor(230, 60, 60) : ofColor(60, 200, 120);
-        bannerW = bannerFont.stringWidth(result);
-        bannerHeight = bannerFont.stringHeight(result) + 42 + 24;
-    } else {
-        bannerHeight = bannerFont.stringHeight("NORMAL") + 42 + 24;
+    const std::string& result = keys_.banner;
+    const glm::vec2 bannerText = textSize(bannerFont, result);
+    const float bannerW = bannerText.x + 48, bannerH = bannerText.y + 42 + 24;
+    if (haveCamera && rd.stage == SmileFlow::STAGE_EVALUATE &&
+        banner_.stale(result, pixels(bannerW, scale), pixels(bannerH, scale))) {
+        beginLayer(banner_.fbo, scale);
+        ofSetColor(0, 0, 0, 100);
+        ofDrawRectangle(0, 0, bannerW, bannerH);
+        ofSetColor(rd.abnormal ? ofColor(230, 60, 60) : ofColor(60, 200, 120));
+        bannerFont.drawString(result, 24, bannerH/2 + bannerText.y/2);
+        endLayer(banner_.fbo);
+    }
+
+    frame_.begin();
+    ofPushMatrix();
+    ofScale(scale, scale);
+    ofSetColor(15, 15, 15);
+    ofDrawRectangle(0, 0, winW, winH);
+
+    if (!haveCamera) {
+        ofSetColor(0, 0, 255);
+        ofDrawRectangle(0, 0, winW, winH);
+        ofSetColor(255);
+        std::string msg = "Camera not initialized! Check camera connection and permissions.";
+        if (!rd.label.empty()) msg = rd.label + ": " + msg;
+        ofDrawBitmapString(msg, 40, 80);
+        ofPopMatrix();
+        frame_.end();
+        return;
     }
 
-    float camAspect = 1280.0f / 720.0f;
+    const guide::GuideGeometry& geo = rd.geometry;
+    const float frameW = (float)geo.frameWidth;
+    const float frameH = (float)geo.frameHeight;
+    float camAspect = frameW / frameH;
     float winAspect = float(winW) / float(winH);
     float camDrawW, camDrawH;
     if (winAspect > camAspect) {
@@ -48,101 +222,56 @@ void ViewRenderer::draw(const RenderData& rd) {
     }
     float camX = (winW - camDrawW) / 2.0f;
     float camY = (winH - camDrawH) / 2.0f;
+    float sx = camDrawW / frameW;
+    float sy = camDrawH / frameH;
 
-    float spaceAbove = (totalHeight + 50);
-    float spaceBelow = (bannerHeight + 60);
-    float availableH = camDrawH - spaceAbove - spaceBelow;
-    float ovalCenterY = camY + spaceAbove + availableH/2.0f;
-    float ovalCenterX = camX + camDrawW/2.0f;
-
-    float ovalA = camDrawW * 0.13f;
-    float ovalB = camDrawH * 0.28f;
+    // The tracker's guide oval, in window coordinates for the text layout.
+    float ovalFrameX  = rd.mirrorView ? frameW - geo.oval.center.x : geo.oval.center.x;
+    float ovalCenterX = camX + ovalFrameX * sx;
+    float ovalCenterY = camY + geo.oval.center.y * sy;
+    float ovalB = geo.oval.b * sy;
 
     ofPushMatrix();
     ofTranslate(camX, camY);
-    ofScale(camDrawW / 1280.0f, camDrawH / 720.0f);
+    ofScale(sx, sy);
     if (rd.mirrorView) {
-        ofTranslate(1280, 0);
+        ofTranslate(frameW, 0);
         ofScale(-1, 1);
     }
-    rd.grabber->draw(0, 0);
+    ofSetColor(255);
+    rd.camera->draw(0, 0);
 
     ofPushStyle();
-    bool isOkColor = false;
-    if (rd.tracker && !rd.tracker->getInstances().empty()) {
-        auto& inst = rd.tracker->getInstances().front();
-        auto& lms  = inst.getLandmarks();
-        auto pts   = lms.getImagePoints();
-        int insideCount = 0;
-        for (const auto& p : pts) {
-            float nx = (p.x - 1280.0f/2) / (1280.0f*0.13f);
-            float ny = (p.y - 720.0f/2) / (720.0f*0.28f);
-            if (nx*nx + ny*ny <= 1.f) insideCount++;
-        }
-        bool inside = (pts.empty() ? false : (insideCount >= (int)(0.92f * pts.size())));
-        isOkColor = inside && (rd.stage != SmileFlow::STAGE_ALIGN);
-    }
+    bool isOkColor = rd.insideGuide && (rd.stage != SmileFlow::STAGE_ALIGN);
     ofNoFill();
     ofSetLineWidth(1.5f);
     ofSetColor(isOkColor ? ofColor(40, 220, 120) : ofColor(230, 70, 70));
-    float ovalCenterY_cam = (ovalCenterY - camY) / (camDrawH / 720.0f);
-    float ovalCenterX_cam = (ovalCenterX - camX) / (camDrawW / 1280.0f);
-    ofDrawEllipse(ovalCenterX_cam, ovalCenterY_cam,
-                  2.f * (ovalA / (camDrawW / 1280.0f)),
-                  2.f * (ovalB / (camDrawH / 720.0f)));
+    ofDrawEllipse(geo.oval.center.x, geo.oval.center.y, 2.f * geo.oval.a, 2.f * geo.oval.b);
     ofPopStyle();
 
-    if (rd.tracker) {
-        rd.tracker->drawDebug();
+    if (rd.faces) {
+        FaceTrackerAdapter::drawFaces(*rd.faces);
     }
     ofSetLineWidth(1.0f);
 
     ofPopMatrix();
 
     if (rd.stage == SmileFlow::STAGE_HOME) {
-        ofSetColor(30, 30, 30, 180);
-        ofDrawRectangle(0, 0, winW, winH);
-        ofSetColor(255);
-        std::string title = "Facial Stroke Detector";
-        bannerFont.drawString(title, winW/2 - bannerFont.stringWidth(title)/2, winH/5);
-        std::vector<std::string> lines = {
-            "Welcome!", "",
-            "How it works:",
-            "- Align your head inside the oval",
-            "- Hold still until progress completes",
-            "- Show your teeth (smile)",
-            "- System checks for mouth asymmetry", "", "Press any key to begin"
-        };
-        for(size_t i=0;i<lines.size();++i){
-            instrFont.drawString(lines[i], winW/2 - instrFont.stringWidth(lines[i])/2, winH/5 + 80 + i*38);
-        }
-        return;
-    }
-
-    ofPushStyle();
-    float y_above = ovalCenterY - ovalB - totalHeight - 22;
-    ofSetColor(0, 0, 0, 100);
-    ofDrawRectangle(ovalCenterX - maxWidth/2 - 20, y_above - 18, maxWidth + 40, totalHeight + 24);
-    ofSetColor(255);
-    float y = y_above;
-    for (const auto& line : rd.lines) {
-        float w = instrFont.stringWidth(line);
-        instrFont.drawString(line, ovalCenterX - w/2, y + instrFont.stringHeight(line));
-        y += instrFont.stringHeight(line) + 8;
-    }
+        drawLayer(home_.fbo, 0, 0, winW, winH);
+    } else {
+        float y_above = ovalCenterY - ovalB - totalHeight - 22;
+        if (lines.size()) drawLayer(instructions_.fbo, ovalCenterX - boxW/2, y_above - 18, boxW, boxH);
 
-    if (rd.stage == SmileFlow::STAGE_EVALUATE) {
-        float ovalBot = ovalCenterY + ovalB;
-        float resultBoxHeight = bannerFont.stringHeight(result) + 42 + 24;
-        float centerY = ovalBot + (winH - ovalBot) / 2.0f;
+        if (rd.stage == SmileFlow::STAGE_EVALUATE) {
+            float ovalBot = ovalCenterY + ovalB;
+            float centerY = ovalBot + (winH - ovalBot) / 2.0f;
+            drawLayer(banner_.fbo, ovalCenterX - bannerW/2, centerY - bannerH/2, bannerW, bannerH);
+        }
 
-        ofSetColor(0, 0, 0, 100);
-        ofDrawRectangle(ovalCenterX - bannerW/2 - 24, centerY - resultBoxHeight/2, bannerW + 48, resultBoxHeight);
-        ofSetColor(resultColor);
-        bannerFont.drawString(result, ovalCenterX - bannerW/2, centerY + bannerFont.stringHeight(result)/2);
+        ofSetColor(255);
+        int statLines = (int)std::count(stats_.begin(), stats_.end(), '\n');
+        ofDrawBitmapStringHighlight(stats_, 20, winH - 30 - 14 * statLines);
     }
-
-    ofSetColor(255);
-    ofDrawBitmapStringHighlight("Framerate : " + ofToString(ofGetFrameRate()), 20, winH - 30);
-    ofPopStyle();
+    ofPopMatrix();
+    frame_.end();
 }
@@ -1,23 +1,74 @@
 #pragma once
 #include "ofMain.h"
-#include "ofxFaceTracker2.h"
+#include <unordered_map>
+#include "FaceTrackerAdapter.h"
 #include "SmileFlow.h"
+#include "TrackingPipeline.h"
 
 struct RenderData {
     bool mirrorView = true;
     ofTrueTypeFont* fontMedium = nullptr;
     ofTrueTypeFont* fontLarge  = nullptr;
     SmileFlow::Stage stage = SmileFlow::STAGE_HOME;
+    bool ready = true;        // false while the landmark model is loading
     bool abnormal = false;
-    std::vector<std::string> lines;
+    bool insideGuide = false; // from the tracker's derolled landmarks
+    const SmileFlow::UiText* lines = nullptr;
     float stabilityProgress = 0.f;
     float smileIntensity = 0.f;
     float smileAsymmetry = 0.f;
-    ofVideoGrabber*  grabber = nullptr;
-    ofxFaceTracker2* tracker = nullptr;
+    const ofTexture* camera = nullptr;
+    guide::GuideGeometry geometry;  // of the camera frame
+    const std::vector<TrackedFace>* faces = nullptr; // camera image coordinates
+    // Where to draw; empty for the whole window. A smaller viewport gets the
+    // full-window layout scaled down into it.
+    ofRectangle viewport;
+    std::string label;      // station name, shown with its frame rates
+    float cameraFps = 0.f;
+    float trackFps = 0.f;
 };
 
+// The tracking fields of rd from one pipeline result; rd then points into res.
+void fillRenderData(const TrackingPipeline::Result& res, RenderData& rd);
+
+// Draws one station's view. The view is composed into an offscreen buffer
+// only when something on it changed, i.e. after invalidate(), a viewport
+// change or a new frame-rate readout (at most twice a second); every other
+// draw() just shows that buffer. The home screen, instruction box and
+// verdict banner are kept in buffers of their own and text sizes are
+// measured once per string.
 class ViewRenderer {
 public:
+    // New camera frame or tracking result.
+    void invalidate() { dirty_ = true; }
     void draw(const RenderData& rd);
+    uint64_t composedFrames() const { return composed_; }
+
+    // What each layer shows, as Layer::stale() compares it. compose() derives
+    // them for every recompose; no fonts or GL are involved.
+    struct LayerKeys {
+        std::string home, lines, banner;
+    };
+    static void layerKeys(const RenderData& rd, LayerKeys& keys);
+
+private:
+    struct Layer {
+        ofFbo       fbo;
+        std::string key;
+        // True when fbo has to be redrawn to show key at w x h pixels.
+        bool stale(const std::string& k, int w, int h);
+    };
+
+    // Everything in a winW x winH window at the origin, scale pixels per unit.
+    void compose(const RenderData& rd, int winW, int winH, float scale);
+    glm::vec2 textSize(ofTrueTypeFont& font, const std::string& s);
+
+    ofFbo       frame_;
+    bool        dirty_ = true;
+    uint64_t    composed_ = 0;
+    std::string stats_;
+    float       statsAt_ = -1.f;
+    Layer       home_, instructions_, banner_;
+    LayerKeys   keys_;
+    std::unordered_map<const ofTrueTypeFont*, std::unordered_map<std::string, glm::vec2>> textSizes_;
 };
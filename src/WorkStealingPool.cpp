@@ -0,0 +1,77 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(size_t workers)
+    : queues_(std::max<size_t>(1, workers)) {
+    for (size_t w = 1; w < queues_.size(); ++w) threads_.emplace_back(&WorkStealingPool::workerLoop, this, w);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+bool WorkStealingPool::popLocal(size_t worker, size_t& task) {
+    Queue& q = queues_[worker];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty()) return false;
+    task = q.tasks.front();
+    q.tasks.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t thief, size_t& task) {
+    for (size_t k = 1; k < queues_.size(); ++k) {
+        Queue& q = queues_[(thief + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) continue;
+        task = q.tasks.back();
+        q.tasks.pop_back();
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::drain(size_t worker, const std::function<void(size_t, size_t)>& fn) {
+    size_t task;
+    while (popLocal(worker, task) || steal(worker, task)) fn(worker, task);
+}
+
+void WorkStealingPool::workerLoop(size_t worker) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) return;
+        seen = generation_;
+        const auto& fn = *fn_;
+        lock.unlock();
+        drain(worker, fn);
+        lock.lock();
+        if (--busy_ == 0) done_.notify_one();
+    }
+}
+
+void WorkStealingPool::run(size_t numTasks, const std::function<void(size_t, size_t)>& fn) {
+    for (size_t t = 0; t < numTasks; ++t) {
+        queues_[t % queues_.size()].tasks.push_back(t);
+    }
+    // Every task is queued before any worker wakes, so a worker that finds
+    // all deques empty is done. run() returns only once every worker has
+    // checked in, so none can sleep through the next run's wake-up.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        busy_ = threads_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+    drain(0, fn);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return busy_ == 0; });
+    fn_ = nullptr;
+}
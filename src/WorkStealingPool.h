@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs a known set of tasks on a fixed number of threads. Tasks are dealt
+// round-robin into per-worker deques; a worker pops from the front of its own
+// deque and, once that is empty, steals from the back of the others'.
+// The calling thread is worker 0; the others are started once and sleep
+// between runs, so a run costs a wake-up rather than thread creation.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t workers);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t size() const { return queues_.size(); }
+
+    // Blocks until fn(worker, task) has run for every task in [0, numTasks).
+    void run(size_t numTasks, const std::function<void(size_t worker, size_t task)>& fn);
+
+private:
+    struct Queue {
+        std::mutex         mutex;
+        std::deque<size_t> tasks;
+    };
+    bool popLocal(size_t worker, size_t& task);
+    bool steal(size_t thief, size_t& task);
+    void drain(size_t worker, const std::function<void(size_t, size_t)>& fn);
+    void workerLoop(size_t worker);
+
+    std::vector<Queue> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_, done_;
+    const std::function<void(size_t, size_t)>* fn_ = nullptr;
+    uint64_t generation_ = 0; // runs started
+    size_t   busy_ = 0;       // workers other than 0 still draining this run
+    bool     stop_ = false;
+};
@@ -1,10 +1,142 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "AllocCheck.h"
+#include "BatchRunner.h"
+#include "Benchmarks.h"
+#include "DetectorBenchmark.h"
+#include "IngestService.h"
+#include "Metrics.h"
+#include "Replay.h"
+#include "Soak.h"
+
+int main(int argc, char* argv[]) {
+    // Headless modes: no window, GL context or camera.
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        ofInit();
+        return batch::main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return bench::main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--detect-bench") {
+        ofInit();
+        return detectbench::main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--alloc-check") {
+        return alloccheck::main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--soak") {
+        return soak::main(argc - 1, argv + 1);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--replay") {
+        ofInit();
+        return replay::main(argc - 1, argv + 1);
+    }
+    // --serve: screen frames other local processes put in shared memory,
+    // see IngestService.h; --ingest-client plays clips into it for testing.
+    if (argc > 1 && std::string(argv[1]) == "--serve") {
+        ofInit();
+        return ingest::serve(argc - 1, argv + 1);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--ingest-client") {
+        ofInit();
+        return ingest::client(argc - 1, argv + 1);
+    }
+    // --convert-model [in.dat [out.lmm]]: one-time conversion to the mapped
+    // layout; LandmarkModel::load() picks up the .lmm next to the .dat.
+    if (argc > 1 && std::string(argv[1]) == "--convert-model") {
+        ofInit();
+        std::string dat = argc > 2 ? argv[2] : TrackingPipeline::Settings().modelPath;
+        std::string lmm = argc > 3 ? argv[3] : LandmarkModel::cachePath(dat);
+        return LandmarkModel::convert(dat, lmm) ? 0 : 1;
+    }
+
+    // Live options: --camera WxH (e.g. 640x480 on low-power terminals),
+    // --track-scale f to detect and landmark on a downscaled copy,
+    // --infer-every n to fit landmarks on at most every nth quiet frame,
+    // --budget ms to let the tracker trade quality for a frame-time budget,
+    // --detector hog[:threads]|haar|reuse[:name] to pick the face detector,
+    // --record file.lmk to keep session landmarks for --replay,
+    // --sessions dir [--session-format jpg|png|avi] to keep an audit copy
+    // of every session's frames, overlays and landmarks,
+    // --no-gate to track dark, blown-out and blurred frames as well, or
+    // --gate-sharpness f to set the blur threshold,
+    // --cameras 0,1,... to run one station per camera device, tiled,
+    // --track-slots n to let at most n stations track at the same time, and
+    // --metrics-port n and/or --metrics-file path [--metrics-interval s] to
+    // export frame rates, tracker and flow figures for Prometheus.
+    TrackingPipeline::Settings pipeline;
+    metrics::Exporter::Settings metricsOut;
+    std::vector<int> cameras;
+    int trackSlots = std::max(1, (int)std::thread::hardware_concurrency() - 2);
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() { return i + 1 < argc ? std::string(argv[++i]) : std::string(); };
+        if (a == "--camera") {
+            auto wh = ofSplitString(value(), "x");
+            if (wh.size() == 2) {
+                pipeline.camWidth  = ofToInt(wh[0]);
+                pipeline.camHeight = ofToInt(wh[1]);
+            }
+        } else if (a == "--track-scale") {
+            pipeline.trackingScale = ofToFloat(value());
+        } else if (a == "--infer-every") {
+            pipeline.inference.every = std::max(1, ofToInt(value()));
+        } else if (a == "--budget") {
+            pipeline.quality.budgetSeconds = ofToDouble(value()) / 1000.0;
+        } else if (a == "--detector") {
+            pipeline.detector = value();
+        } else if (a == "--model") {
+            pipeline.modelPath = value();
+        } else if (a == "--record") {
+            pipeline.recordPath = value();
+        } else if (a == "--sessions") {
+            pipeline.sessions.dir = value();
+        } else if (a == "--session-format") {
+            pipeline.sessions.format = value();
+        } else if (a == "--no-gate") {
+            pipeline.gate.enabled = false;
+        } else if (a == "--gate-sharpness") {
+            pipeline.gate.minSharpness = ofToFloat(value());
+        } else if (a == "--cameras") {
+            for (const auto& id : ofSplitString(value(), ",", true, true)) cameras.push_back(ofToInt(id));
+        } else if (a == "--track-slots") {
+            trackSlots = std::max(1, ofToInt(value()));
+        } else if (a == "--metrics-port") {
+            metricsOut.port = ofToInt(value());
+        } else if (a == "--metrics-file") {
+            metricsOut.file = value();
+        } else if (a == "--metrics-interval") {
+            metricsOut.interval = ofToFloat(value());
+        }
+    }
+    // Every station would otherwise quietly fall back to HOG.
+    if (!detectors::make(pipeline.detector)) {
+        ofLogError("main") << "usage: --detector hog[:threads]|haar|reuse[:name]";
+        return 2;
+    }
+    pipeline.metrics = metricsOut.enabled();
+    std::vector<TrackingPipeline::Settings> stations;
+    if (cameras.empty()) stations.push_back(pipeline);
+    for (size_t i = 0; i < cameras.size(); ++i) {
+        TrackingPipeline::Settings s = pipeline;
+        s.deviceId = cameras[i];
+        s.station = ofToString(i + 1);
+        // One recording per station: rec.lmk becomes rec-1.lmk, rec-2.lmk, ...
+        if (!s.recordPath.empty() && cameras.size() > 1) {
+            s.recordPath = ofFilePath::removeExt(s.recordPath) + "-" + ofToString(i + 1) + ".lmk";
+        }
+        if (!s.sessions.dir.empty() && cameras.size() > 1) {
+            s.sessions.dir = ofFilePath::join(s.sessions.dir, "station-" + ofToString(i + 1));
+        }
+        stations.push_back(s);
+    }
 
-int main() {
     ofGLFWWindowSettings settings;
     settings.setSize(800, 1200); // Good default for vertical layout, but can be any size.
     settings.resizable = true;   // Allow maximizing/resizing.
     ofCreateWindow(settings);
-    ofRunApp(new ofApp());
+    metrics::Exporter exporter;
+    if (metricsOut.enabled()) exporter.start(metricsOut);
+    ofRunApp(new ofApp(stations, trackSlots));
 }
@@ -1,12 +1,37 @@
 #include "ofApp.h"
-#include "Landmarks68.h"
+#include "Profiler.h"
+#include <chrono>
+
+namespace {
+// Taken during static initialization, i.e. about when the process started.
+const auto kProcessStart = std::chrono::steady_clock::now();
+
+double sinceProcessStart() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - kProcessStart).count();
+}
+} // namespace
 
 void ofApp::setup() {
     fontMedium_.load("verdana.ttf", 28, true, true);
     fontLarge_.load("verdana.ttf", 48, true, true);
 
-    grabber_.setup(1280, 720);
-    tracker_.setup("model/shape_predictor_68_face_landmarks.dat");
+    // Capture and tracking run on their own threads; this thread only
+    // uploads the newest frames and draws the newest results.
+    stations_.clear();
+    for (size_t i = 0; i < settings_.size(); ++i) {
+        auto st = std::make_unique<Station>();
+        if (settings_.size() > 1) st->label = "Station " + ofToString(i + 1);
+        st->pipeline.setup(settings_[i], settings_.size() > 1 ? &gate_ : nullptr);
+        if (settings_[i].metrics) {
+            auto& r = metrics::Registry::global();
+            const metrics::Labels labels = { { "station", settings_[i].station } };
+            st->cameraFps = &r.gauge("stroke_camera_fps", "Frames per second delivered by the camera.", labels);
+            st->trackFps = &r.gauge("stroke_track_fps", "Frames per second the tracker got through.", labels);
+            drawFps_ = &r.gauge("stroke_draw_fps", "Frames per second drawn.");
+        }
+        stations_.push_back(std::move(st));
+    }
+    layoutTiles();
 
     mirrorView_ = true;
     ofSetFrameRate(60);
@@ -14,58 +39,109 @@ void ofApp::setup() {
 }
 
 void ofApp::update() {
-    static float last = ofGetElapsedTimef();
-    float now = ofGetElapsedTimef();
-    float dt = now - last;
-    last = now;
-
-    grabber_.update();
-    tracker_.update(grabber_);
-
-    DerolledData der;
-    bool haveDer = tracker_.getDerolled(der);
+    PROFILE_SCOPE(prof::FRAME);
+    bool anyNew = false;
+    for (auto& st : stations_) {
+        TrackingPipeline& pipeline = st->pipeline;
+        bool isNew = pipeline.newFrame();
+        anyNew = anyNew || isNew;
+        if (isNew) {
+            st->view.invalidate();
+            if (firstCameraFrameAt_ < 0) {
+                firstCameraFrameAt_ = sinceProcessStart();
+                ofLogNotice("startup") << "first camera frame after " << ofToString(firstCameraFrameAt_, 2) << " s";
+            }
+            const ofPixels& px = pipeline.frame().pixels;
+            st->cameraTex.loadData(px);
+            if ((int)px.getWidth() != st->geometry.frameWidth || (int)px.getHeight() != st->geometry.frameHeight) {
+                st->geometry = guide::geometryFor((int)px.getWidth(), (int)px.getHeight());
+            }
+        }
+        if (!pipeline.newResult()) continue;
+        st->view.invalidate();
+        if (st->cameraFps) {
+            st->cameraFps->set(pipeline.result().cameraFps);
+            st->trackFps->set(pipeline.result().trackFps);
+        }
+        if (readyAt_ < 0 && pipeline.result().ready) {
+            readyAt_ = sinceProcessStart();
+            ofLogNotice("startup") << "ready for a session after " << ofToString(readyAt_, 2) << " s";
+        }
+    }
+    PROFILE_FRAME(anyNew);
+    if (drawFps_) drawFps_->set(ofGetFrameRate());
 
-    SmileFlow::Inputs in;
-    in.hasFace        = tracker_.hasFace();
-    in.insideGuide    = haveDer ? der.insideGuide : false;
-    in.dt             = dt;
-    in.iod            = haveDer ? der.iod : 1.f;
-    in.faceCenter     = haveDer ? der.faceCenter : glm::vec2(0,0);
-    in.derolledPoints = haveDer ? der.points : std::vector<glm::vec2>{};
-    if (haveDer && der.points.size() > LM_RIGHT_MOUTH_CORNER) {
-        in.haveMouth  = true;
-        in.mouthLeft  = der.points[LM_LEFT_MOUTH_CORNER];
-        in.mouthRight = der.points[LM_RIGHT_MOUTH_CORNER];
+#if STROKE_PROFILE
+    float now = ofGetElapsedTimef();
+    if (now - lastProfileDump_ >= kProfileDumpSeconds) {
+        prof::dumpJson("profile.json");
+        prof::dumpCsv("profile.csv");
+        lastProfileDump_ = now;
     }
-    flow_.update(in);
+#endif
 }
 
 void ofApp::draw() {
-    RenderData rd;
-    rd.mirrorView = mirrorView_;
-    rd.fontMedium = &fontMedium_;
-    rd.fontLarge  = &fontLarge_;
-    rd.stage      = flow_.stage();
-    rd.abnormal   = flow_.abnormal();
-    rd.lines      = flow_.uiLines();
-    rd.stabilityProgress = flow_.stabilityProgress();
-    rd.smileIntensity    = flow_.smileIntensity();
-    rd.smileAsymmetry    = flow_.smileAsymmetry();
-    rd.grabber = &grabber_;
-    rd.tracker = &tracker_.tracker();
-    view_.draw(rd);
+    if (firstDrawAt_ < 0) {
+        firstDrawAt_ = sinceProcessStart();
+        ofLogNotice("startup") << "first frame drawn after " << ofToString(firstDrawAt_, 2) << " s";
+    }
+    for (const auto& st : stations_) {
+        const TrackingPipeline::Result& res = st->pipeline.result();
+        RenderData rd;
+        rd.mirrorView = mirrorView_;
+        rd.fontMedium = &fontMedium_;
+        rd.fontLarge  = &fontLarge_;
+        fillRenderData(res, rd);
+        rd.camera   = &st->cameraTex;
+        rd.geometry = st->geometry;
+        rd.viewport = st->tile;
+        rd.label    = st->label;
+        st->view.draw(rd);
+    }
+}
+
+void ofApp::exit() {
+    for (auto& st : stations_) st->pipeline.stop();
 }
 
+// '1'..'9' start that station, 'r' resets every station and any other key
+// starts every station that is on its home screen.
 void ofApp::keyPressed(int key) {
     if (key == 'r' || key == 'R') {
-        flow_.reset();
+        for (auto& st : stations_) st->pipeline.requestReset();
+    } else if (key >= '1' && key <= '9') {
+        size_t i = size_t(key - '1');
+        if (i < stations_.size()) stations_[i]->pipeline.requestStart();
     } else {
-        if (flow_.stage() == SmileFlow::STAGE_HOME) {
-            flow_.reset();
-        }
+        for (auto& st : stations_) st->pipeline.requestStart();
+    }
+}
+
+// Clicking a tile starts that station.
+void ofApp::mousePressed(int x, int y, int) {
+    for (auto& st : stations_) {
+        if (st->tile.isEmpty() || st->tile.inside(x, y)) st->pipeline.requestStart();
     }
 }
 
 void ofApp::windowResized(int, int) {
-    // No-op
+    layoutTiles();
+    for (auto& st : stations_) st->view.invalidate();
+}
+
+// As square a grid as the station count allows, filled row by row. One
+// station leaves its tile empty, i.e. the whole window.
+void ofApp::layoutTiles() {
+    if (stations_.size() < 2) {
+        for (auto& st : stations_) st->tile = ofRectangle();
+        return;
+    }
+    int n = (int)stations_.size();
+    int cols = (int)std::ceil(std::sqrt((double)n));
+    int rows = (n + cols - 1) / cols;
+    float w = float(ofGetWidth()) / cols, h = float(ofGetHeight()) / rows;
+    for (int i = 0; i < n; ++i) {
+        stations_[i]->tile.set((i % cols) * w, (i / cols) * h, w, h);
+    }
 }
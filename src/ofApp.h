@@ -1,21 +1,49 @@
 #pragma once
 #include "ofMain.h"
-#include "FaceTrackerAdapter.h"
-#include "SmileFlow.h"
+#include <memory>
+#include "FairGate.h"
+#include "Metrics.h"
+#include "TrackingPipeline.h"
 #include "ViewRenderer.h"
+#include "Profiler.h"
 
 class ofApp : public ofBaseApp {
 public:
+    // One station per camera, each with its own pipeline, tiled in the
+    // window. At most trackSlots stations track at the same time.
+    explicit ofApp(const std::vector<TrackingPipeline::Settings>& stations = { {} }, int trackSlots = 1)
+        : settings_(stations), gate_(trackSlots) {}
+
     void setup() override;
     void update() override;
     void draw() override;
+    void exit() override;
     void keyPressed(int key) override;
+    void mousePressed(int x, int y, int button) override;
     void windowResized(int w, int h) override;
 private:
-    ofVideoGrabber grabber_;
-    FaceTrackerAdapter tracker_;
-    SmileFlow         flow_;
-    ViewRenderer      view_;
+    struct Station {
+        TrackingPipeline pipeline;
+        ofTexture        cameraTex;
+        guide::GuideGeometry geometry; // of the frames in cameraTex
+        ofRectangle      tile;
+        std::string      label;
+        ViewRenderer     view;
+        metrics::Gauge*  cameraFps = nullptr; // set when the station reports metrics
+        metrics::Gauge*  trackFps = nullptr;
+    };
+    void layoutTiles();
+
+    std::vector<TrackingPipeline::Settings> settings_;
+    FairGate         gate_;
+    std::vector<std::unique_ptr<Station>> stations_;
     bool        mirrorView_ = true;
+    metrics::Gauge* drawFps_ = nullptr;
     ofTrueTypeFont fontLarge_, fontMedium_;
+    // Seconds from process start; -1 until it happens.
+    double firstDrawAt_ = -1, firstCameraFrameAt_ = -1, readyAt_ = -1;
+#if STROKE_PROFILE
+    static constexpr float kProfileDumpSeconds = 10.f;
+    float lastProfileDump_ = 0.f;
+#endif
 };